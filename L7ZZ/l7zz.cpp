@@ -3,6 +3,13 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+#include "../comun/async_io.h"
+#include "../comun/batch.h"
+#include "../comun/dictionary.h"
+#include "../comun/metrics.h"
 
 struct LZ77Token {
     int offset;
@@ -10,29 +17,37 @@ struct LZ77Token {
     char nextChar;
 };
 
-class LZ77 {
-private:
-    static const int WINDOW_SIZE = 1024; 
+// Nucleo del compresor especializado en tiempo de compilacion: con la
+// ventana constante, los limites del bucle se pliegan y cada nivel tiene su
+// propio bucle sin ramas de configuracion.
+template <size_t WindowSize>
+struct LZ77Kernel {
+    static size_t compress(const char* text, size_t cursor, size_t textSize, LZ77Token* out, size_t capacity) {
+        size_t tokenCount = 0;
+        size_t probes = 0;
+        size_t matches = 0;
+        size_t matchLengthTotal = 0;
 
-public:
-    std::vector<LZ77Token> compress(const std::string& text) {
-        std::vector<LZ77Token> tokens;
-        size_t cursor = 0;
+        while (cursor < textSize) {
+            size_t bestOffset = 0;
+            size_t bestLength = 0;
 
-        while (cursor < text.size()) {
-            int bestOffset = 0;
-            int bestLength = 0;
-            
-            int searchStart = std::max(0, static_cast<int>(cursor) - WINDOW_SIZE);
+            const size_t searchStart = cursor > WindowSize ? cursor - WindowSize : 0;
+            const size_t remaining = textSize - cursor;
 
             for (size_t searchCursor = searchStart; searchCursor < cursor; ++searchCursor) {
+                // La coincidencia no puede pasar del cursor ni del final del
+                // texto; ese tope solo decrece, asi que se corta en cuanto
+                // ya no puede superar a la mejor.
+                const size_t maxLength = std::min(cursor - searchCursor, remaining);
+                if (maxLength <= bestLength) {
+                    break;
+                }
+                probes++;
+
                 size_t matchLength = 0;
-                while (cursor + matchLength < text.size() &&
-                       text[searchCursor + matchLength] == text[cursor + matchLength]) {
+                while (matchLength < maxLength && text[searchCursor + matchLength] == text[cursor + matchLength]) {
                     matchLength++;
-                    if (searchCursor + matchLength >= cursor) {
-                        break;
-                    }
                 }
 
                 if (matchLength > bestLength) {
@@ -41,73 +56,274 @@ public:
                 }
             }
 
-            char nextChar = (cursor + bestLength < text.size()) ? text[cursor + bestLength] : '\0';
-            tokens.push_back({bestOffset, bestLength, nextChar});
+            if (tokenCount == capacity) {
+                throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+            }
+            char nextChar = (cursor + bestLength < textSize) ? text[cursor + bestLength] : '\0';
+            out[tokenCount++] = {static_cast<int>(bestOffset), static_cast<int>(bestLength), nextChar};
+            matches += bestLength > 0 ? 1 : 0;
+            matchLengthTotal += bestLength;
 
             cursor += bestLength + 1;
         }
 
-        return tokens;
+        // Un '\0' en el ultimo token marca que la coincidencia llego al
+        // final y no hay siguiente caracter. Si el texto termina en un '\0'
+        // real, un token vacio cierra el flujo para que no se confundan.
+        if (tokenCount > 0 && cursor == textSize && out[tokenCount - 1].nextChar == '\0') {
+            if (tokenCount == capacity) {
+                throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+            }
+            out[tokenCount++] = {0, 0, '\0'};
+        }
+
+        METRIC_ADD("lz77_match_probes_total", probes);
+        METRIC_ADD("lz77_matches_total", matches);
+        METRIC_ADD("lz77_match_length_total", matchLengthTotal);
+        METRIC_ADD("lz77_tokens_total", tokenCount);
+        return tokenCount;
     }
+};
 
-    std::string decompress(const std::vector<LZ77Token>& tokens) {
-        std::string decompressed;
+class LZ77 {
+public:
+    static constexpr int LEVEL_COUNT = 4;
+    static constexpr int DEFAULT_LEVEL = 2;
+
+    // El diccionario se guarda completo para la ventana mas grande, asi el
+    // descompresor no necesita saber con que nivel se comprimio.
+    static constexpr size_t DICTIONARY_SIZE = 8192;
+
+private:
+    using Kernel = size_t (*)(const char*, size_t, size_t, LZ77Token*, size_t);
+
+    // Niveles instanciados de antemano, uno por tamaño de ventana. El nivel 2
+    // es la ventana original y produce los mismos tokens. Cada token ocupa
+    // lo mismo sea literal o coincidencia, asi que toda coincidencia sirve y
+    // no hay un minimo por nivel.
+    static constexpr Kernel KERNELS[LEVEL_COUNT] = {
+        &LZ77Kernel<256>::compress,
+        &LZ77Kernel<1024>::compress,
+        &LZ77Kernel<4096>::compress,
+        &LZ77Kernel<DICTIONARY_SIZE>::compress,
+    };
+
+    Kernel kernel = KERNELS[DEFAULT_LEVEL - 1];
+
+    // Diccionario precargado en la ventana y buffer reutilizable con
+    // diccionario + texto.
+    std::string dictionary;
+    std::string history;
+
+public:
+    // Elige el nucleo del nivel (1 a LEVEL_COUNT); no afecta al formato.
+    void setLevel(int level) {
+        level = std::max(1, std::min(level, LEVEL_COUNT));
+        kernel = KERNELS[level - 1];
+    }
+
+    // Precarga la ventana con un diccionario entrenado. El descompresor debe
+    // cargar el mismo diccionario.
+    void loadDictionary(const std::string& dict) {
+        metrics::PhaseTimer modelTimer;
+        size_t keep = std::min(dict.size(), DICTIONARY_SIZE);
+        dictionary.assign(dict, dict.size() - keep, keep);
+        METRIC_ADD("phase_model_ns_total", modelTimer.elapsedNanoseconds());
+    }
+
+    // Peor caso: un token por cada byte de entrada mas el token que cierra
+    // un texto terminado en '\0'.
+    static size_t compressBound(size_t inputSize) {
+        return inputSize + 1;
+    }
+
+    // Todos los tokens llevan su siguiente caracter, incluso '\0', salvo el
+    // ultimo, donde '\0' marca que no hay ninguno.
+    static bool hasNextChar(const LZ77Token* tokens, size_t index, size_t tokenCount) {
+        return index + 1 < tokenCount || tokens[index].nextChar != '\0';
+    }
+
+    // Los tokens leidos de un archivo pueden traer cualquier valor; uno con
+    // offset o longitud negativos no se puede decodificar.
+    static void checkToken(const LZ77Token& token) {
+        if (token.offset < 0 || token.length < 0) {
+            throw std::runtime_error("Error en la descompresión: token inválido.");
+        }
+    }
+
+    // Tamaño exacto del texto que producen los tokens.
+    static size_t decompressedSize(const LZ77Token* tokens, size_t tokenCount) {
+        size_t size = 0;
+        for (size_t i = 0; i < tokenCount; ++i) {
+            checkToken(tokens[i]);
+            size += tokens[i].length + (hasNextChar(tokens, i, tokenCount) ? 1 : 0);
+        }
+        return size;
+    }
 
-        for (const auto& token : tokens) {
-            size_t start = decompressed.size() - token.offset;
-            for (int i = 0; i < token.length; ++i) {
-                decompressed += decompressed[start + i];
+    // Escribe los tokens en el buffer del llamador sin reservar memoria.
+    // Devuelve la cantidad de tokens escritos.
+    size_t compress(const char* text, size_t textSize, LZ77Token* out, size_t capacity) {
+        metrics::PhaseTimer encodeTimer;
+        size_t tokenCount;
+        if (dictionary.empty()) {
+            tokenCount = kernel(text, 0, textSize, out, capacity);
+        } else {
+            // Los offsets pueden apuntar al diccionario que precede al texto.
+            history.assign(dictionary);
+            history.append(text, textSize);
+            tokenCount = kernel(history.data(), dictionary.size(), history.size(), out, capacity);
+        }
+        METRIC_ADD("phase_encode_ns_total", encodeTimer.elapsedNanoseconds());
+        return tokenCount;
+    }
+
+    // Reconstruye el texto en el buffer del llamador sin reservar memoria.
+    // Devuelve la cantidad de bytes escritos.
+    size_t decompress(const LZ77Token* tokens, size_t tokenCount, char* out, size_t capacity) {
+        metrics::PhaseTimer decodeTimer;
+        size_t size = 0;
+
+        for (size_t t = 0; t < tokenCount; ++t) {
+            const LZ77Token& token = tokens[t];
+            checkToken(token);
+            bool nextChar = hasNextChar(tokens, t, tokenCount);
+            size_t needed = token.length + (nextChar ? 1 : 0);
+            if (static_cast<size_t>(token.offset) > size + dictionary.size() || needed > capacity - size) {
+                throw std::runtime_error("Error en la descompresión: token inválido o buffer insuficiente.");
             }
-            if (token.nextChar != '\0') {
-                decompressed += token.nextChar;
+
+            if (static_cast<size_t>(token.offset) <= size) {
+                size_t start = size - token.offset;
+                for (int i = 0; i < token.length; ++i) {
+                    out[size++] = out[start + i];
+                }
+            } else {
+                // La coincidencia empieza dentro del diccionario.
+                size_t start = size + dictionary.size() - token.offset;
+                for (int i = 0; i < token.length; ++i, ++start) {
+                    out[size++] = start < dictionary.size() ? dictionary[start] : out[start - dictionary.size()];
+                }
+            }
+            if (nextChar) {
+                out[size++] = token.nextChar;
             }
         }
 
+        METRIC_ADD("phase_decode_ns_total", decodeTimer.elapsedNanoseconds());
+        return size;
+    }
+
+    std::vector<LZ77Token> compress(const std::string& text) {
+        std::vector<LZ77Token> tokens(compressBound(text.size()));
+        tokens.resize(compress(text.data(), text.size(), tokens.data(), tokens.size()));
+        return tokens;
+    }
+
+    std::string decompress(const std::vector<LZ77Token>& tokens) {
+        std::string decompressed(decompressedSize(tokens.data(), tokens.size()), '\0');
+        decompressed.resize(decompress(tokens.data(), tokens.size(), &decompressed[0], decompressed.size()));
         return decompressed;
     }
 };
 
-void saveCompressedFile(const std::vector<LZ77Token>& tokens, const std::string& compressedFileName) {
+METRIC_RATIO("lz77_average_match_length", "lz77_match_length_total", "lz77_matches_total");
+
+void writeTokens(std::ostream& out, const LZ77Token* tokens, size_t tokenCount) {
+    out.write(reinterpret_cast<const char*>(&tokenCount), sizeof(tokenCount));
+    for (size_t i = 0; i < tokenCount; ++i) {
+        out.write(reinterpret_cast<const char*>(&tokens[i].offset), sizeof(tokens[i].offset));
+        out.write(reinterpret_cast<const char*>(&tokens[i].length), sizeof(tokens[i].length));
+        out.put(tokens[i].nextChar);
+    }
+}
+
+std::vector<LZ77Token> readTokens(std::istream& in) {
+    size_t tokenCount = 0;
+    in.read(reinterpret_cast<char*>(&tokenCount), sizeof(tokenCount));
+    if (!in) {
+        throw std::runtime_error("Error en la descompresión: archivo comprimido truncado.");
+    }
+
+    std::vector<LZ77Token> tokens;
+    for (size_t i = 0; i < tokenCount; ++i) {
+        LZ77Token token;
+        in.read(reinterpret_cast<char*>(&token.offset), sizeof(token.offset));
+        in.read(reinterpret_cast<char*>(&token.length), sizeof(token.length));
+        token.nextChar = in.get();
+        if (!in) {
+            throw std::runtime_error("Error en la descompresión: archivo comprimido truncado.");
+        }
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+void saveCompressedFile(const std::vector<LZ77Token>& tokens, const std::string& compressedFileName, const std::string& dictionary) {
     std::ofstream outFile(compressedFileName, std::ios::binary);
     if (!outFile.is_open()) {
         std::cerr << "Error al escribir el archivo comprimido." << std::endl;
         return;
     }
 
-    size_t tokenCount = tokens.size();
-    outFile.write(reinterpret_cast<const char*>(&tokenCount), sizeof(tokenCount));
-    for (const auto& token : tokens) {
-        outFile.write(reinterpret_cast<const char*>(&token.offset), sizeof(token.offset));
-        outFile.write(reinterpret_cast<const char*>(&token.length), sizeof(token.length));
-        outFile.put(token.nextChar);
-    }
-
+    writeDictionaryId(outFile, dictionary);
+    writeTokens(outFile, tokens.data(), tokens.size());
     outFile.close();
 }
 
-std::vector<LZ77Token> loadCompressedFile(const std::string& compressedFileName) {
+std::vector<LZ77Token> loadCompressedFile(const std::string& compressedFileName, const std::string& dictionary) {
     std::ifstream inFile(compressedFileName, std::ios::binary);
     if (!inFile.is_open()) {
         std::cerr << "Error al leer el archivo comprimido." << std::endl;
         return {};
     }
 
-    size_t tokenCount;
-    inFile.read(reinterpret_cast<char*>(&tokenCount), sizeof(tokenCount));
-
-    std::vector<LZ77Token> tokens(tokenCount);
-    for (auto& token : tokens) {
-        inFile.read(reinterpret_cast<char*>(&token.offset), sizeof(token.offset));
-        inFile.read(reinterpret_cast<char*>(&token.length), sizeof(token.length));
-        token.nextChar = inFile.get();
-    }
-
+    checkDictionaryId(inFile, dictionary);
+    auto tokens = readTokens(inFile);
     inFile.close();
     return tokens;
 }
 
-void compressFile(const std::string& inputFileName, const std::string& compressedFileName) {
+// Comprime un bloque del lote o del canal asincrono con el contexto y el
+// buffer de tokens del hilo que lo atiende. Cada bloque lleva la marca del
+// diccionario, porque se descomprime por separado.
+std::string compressBlock(LZ77& lz77, std::vector<LZ77Token>& tokens, const std::string& dictionary, const char* data, size_t size) {
+    tokens.resize(LZ77::compressBound(size));
+    size_t tokenCount = lz77.compress(data, size, tokens.data(), tokens.size());
+
+    std::ostringstream payload(std::ios::binary);
+    writeDictionaryId(payload, dictionary);
+    writeTokens(payload, tokens.data(), tokenCount);
+    return payload.str();
+}
+
+// Descomprime un bloque escrito por compressBlock.
+std::string decompressBlock(LZ77& lz77, const std::string& dictionary, std::istream& payload) {
+    checkDictionaryId(payload, dictionary);
+    return lz77.decompress(readTokens(payload));
+}
+
+void compressFile(const std::string& inputFileName, const std::string& compressedFileName, const std::string& dictionary, int level) {
+    METRICS_BEGIN_RUN();
     LZ77 lz77;
+    lz77.setLevel(level);
+    lz77.loadDictionary(dictionary);
+
+    // Los archivos grandes van por bloques, solapando lectura, compresion
+    // y escritura.
+    if (usePipeline(inputFileName)) {
+        std::vector<LZ77Token> tokens;
+        PipelineStats stats = compressPipelined(inputFileName, compressedFileName, [&](size_t, const char* data, size_t size) {
+            return compressBlock(lz77, tokens, dictionary, data, size);
+        });
+        if (stats.ok) {
+            std::cout << "Archivo comprimido en: " << compressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
+    metrics::PhaseTimer readTimer;
     std::ifstream inputFile(inputFileName);
     if (!inputFile.is_open()) {
         std::cerr << "No se pudo abrir el archivo original." << std::endl;
@@ -116,12 +332,15 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
 
     std::string text((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
     inputFile.close();
+    METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
 
     auto start = std::chrono::high_resolution_clock::now();
     auto tokens = lz77.compress(text);
     auto end = std::chrono::high_resolution_clock::now();
 
-    saveCompressedFile(tokens, compressedFileName);
+    metrics::PhaseTimer writeTimer;
+    saveCompressedFile(tokens, compressedFileName, dictionary);
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     size_t originalSize = text.size();
@@ -133,26 +352,78 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
     std::cout << "Tasa de compresion: " << (compressionRate * 100) << "%" << std::endl;
 }
 
-void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName) {
+void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName, const std::string& dictionary) {
+    METRICS_BEGIN_RUN();
     LZ77 lz77;
-    auto tokens = loadCompressedFile(compressedFileName);
+    lz77.loadDictionary(dictionary);
+
+    PipelineStats stats;
+    bool isBlockFile = decompressPipelined(compressedFileName, decompressedFileName, [&](std::istream& block) {
+        return decompressBlock(lz77, dictionary, block);
+    }, stats);
+    if (isBlockFile) {
+        if (stats.ok) {
+            std::cout << "Archivo descomprimido en: " << decompressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
+    metrics::PhaseTimer readTimer;
+    std::vector<LZ77Token> tokens;
+    try {
+        tokens = loadCompressedFile(compressedFileName, dictionary);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
+    METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
     if (tokens.empty()) {
         std::cerr << "Error al cargar el archivo comprimido." << std::endl;
         return;
     }
 
     auto start = std::chrono::high_resolution_clock::now();
-    auto decompressed = lz77.decompress(tokens);
+    std::string decompressed;
+    try {
+        decompressed = lz77.decompress(tokens);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
     auto end = std::chrono::high_resolution_clock::now();
 
+    metrics::PhaseTimer writeTimer;
     std::ofstream decompressedFile(decompressedFileName);
     decompressedFile << decompressed;
     decompressedFile.close();
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo descomprimido en: " << decompressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
 }
 
+void compressBatchFiles(const std::vector<std::string>& inputs, const std::string& outputDir, const std::string& dictionary, int level) {
+    METRICS_BEGIN_RUN();
+    BatchOptions options;
+
+    // Un contexto por hilo, con sus tablas y buffers reutilizables.
+    std::vector<LZ77> codecs(options.threadCount);
+    std::vector<std::vector<LZ77Token>> tokenBuffers(options.threadCount);
+    for (auto& codec : codecs) {
+        codec.setLevel(level);
+        codec.loadDictionary(dictionary);
+    }
+
+    auto stats = compressBatch(inputs, outputDir, [&](size_t worker, const char* data, size_t size) {
+        return compressBlock(codecs[worker], tokenBuffers[worker], dictionary, data, size);
+    }, [&](size_t worker, std::istream& payload) {
+        return decompressBlock(codecs[worker], dictionary, payload);
+    }, options);
+
+    printBatchStats(stats);
+}
+
 int main() {
 
     system("chcp 65001");
@@ -162,6 +433,9 @@ int main() {
     std::string inputFileName;
     std::string compressedFileName;
     std::string decompressedFileName;
+    std::string dictionaryFileName;
+    std::string dictionary;
+    int level = LZ77::DEFAULT_LEVEL;
 
     while (true) {
         std::cout << "\n--- Menu LZ77 ---" << std::endl;
@@ -169,7 +443,12 @@ int main() {
        
         std::cout << "1. Comprimir archivo" << std::endl;
         std::cout << "2. Descomprimir archivo" << std::endl;
-        std::cout << "3. Salir" << std::endl;
+        std::cout << "3. Entrenar diccionario" << std::endl;
+        std::cout << "4. Cargar diccionario" << std::endl;
+        std::cout << "5. Comprimir lote (directorios o archivos)" << std::endl;
+        std::cout << "6. Exportar metricas (.json o .prom)" << std::endl;
+        std::cout << "7. Cambiar nivel de compresion (actual: " << level << ")" << std::endl;
+        std::cout << "8. Salir" << std::endl;
         std::cout << "Seleccione una opcion: ";
 
         int choice;
@@ -180,14 +459,48 @@ int main() {
             std::cin >> inputFileName;
             std::cout << "Ingrese el nombre del archivo comprimido de salida: ";
             std::cin >> compressedFileName;
-            compressFile(inputFileName, compressedFileName);
+            compressFile(inputFileName, compressedFileName, dictionary, level);
         } else if (choice == 2) {
             std::cout << "Ingrese el nombre del archivo comprimido: ";
             std::cin >> compressedFileName;
             std::cout << "Ingrese el nombre del archivo descomprimido de salida: ";
             std::cin >> decompressedFileName;
-            decompressFile(compressedFileName, decompressedFileName);
+            decompressFile(compressedFileName, decompressedFileName, dictionary);
         } else if (choice == 3) {
+            std::vector<std::string> sampleFileNames;
+            std::string sampleFileName;
+            std::cout << "Ingrese los archivos de muestra ('fin' para terminar): ";
+            while (std::cin >> sampleFileName && sampleFileName != "fin") {
+                sampleFileNames.push_back(sampleFileName);
+            }
+            std::cout << "Ingrese el nombre del diccionario de salida: ";
+            std::cin >> dictionaryFileName;
+            trainDictionaryFile(sampleFileNames, dictionaryFileName, LZ77::DICTIONARY_SIZE);
+        } else if (choice == 4) {
+            std::cout << "Ingrese el nombre del diccionario (el mismo al comprimir y descomprimir): ";
+            std::cin >> dictionaryFileName;
+            dictionary = loadDictionaryFile(dictionaryFileName);
+            std::cout << "Diccionario cargado: " << dictionary.size() << " bytes." << std::endl;
+        } else if (choice == 5) {
+            std::vector<std::string> inputs;
+            std::string input;
+            std::cout << "Ingrese los directorios o archivos a comprimir ('fin' para terminar): ";
+            while (std::cin >> input && input != "fin") {
+                inputs.push_back(input);
+            }
+            std::cout << "Ingrese el directorio de salida: ";
+            std::cin >> compressedFileName;
+            compressBatchFiles(inputs, compressedFileName, dictionary, level);
+        } else if (choice == 6) {
+            std::string metricsFileName;
+            std::cout << "Ingrese el nombre del archivo de metricas: ";
+            std::cin >> metricsFileName;
+            exportMetrics(metricsFileName);
+        } else if (choice == 7) {
+            std::cout << "Ingrese el nivel (1 rapido - " << LZ77::LEVEL_COUNT << " maxima compresion): ";
+            std::cin >> level;
+            level = std::max(1, std::min(level, LZ77::LEVEL_COUNT));
+        } else if (choice == 8) {
             std::cout << "Saliendo..." << std::endl;
             break;
         } else {
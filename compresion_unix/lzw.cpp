@@ -4,67 +4,421 @@
 #include <vector>
 #include <string>
 #include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <limits>
+#include "../comun/async_io.h"
+#include "../comun/batch.h"
+#include "../comun/dictionary.h"
+#include "../comun/magic.h"
+#include "../comun/metrics.h"
 
-class LZWCompression {
-public:
-    std::vector<int> compress(const std::string& text) {
-        std::unordered_map<std::string, int> dictionary;
-        for (int i = 0; i < 256; ++i) {
-            dictionary[std::string(1, i)] = i;
-        }
-
-        std::string current;
-        std::vector<int> compressed;
-        int code = 256;
-
-        for (char c : text) {
-            current += c;
-            if (dictionary.find(current) == dictionary.end()) {
-                dictionary[current] = code++;
-                current.pop_back();
-                compressed.push_back(dictionary[current]);
-                current = c;
+// Codec LZW parametrizado por el tipo de codigo emitido. Con codigos de
+// 16 bits la tabla se congela al llegar a 65536 entradas; con int crece sin
+// limite como en el formato original. El limite es una constante de
+// compilacion, asi que la version de 32 bits no paga la comprobacion.
+template <typename Code>
+class LZWCodec {
+private:
+    static constexpr bool BOUNDED = sizeof(Code) < sizeof(int);
+    static constexpr size_t MAX_CODES = BOUNDED ? size_t(std::numeric_limits<Code>::max()) + 1 : size_t(std::numeric_limits<int>::max());
+
+    // Tabla de frases compartida por compresor y descompresor: cada codigo
+    // >= 256 es una frase previa (prefijo) seguida de un byte (sufijo).
+    // Los vectores crecen al doble a medida que se agregan frases y conservan
+    // su capacidad entre llamadas, asi que en regimen estable no se reserva
+    // memoria y el tamaño sigue a las frases reales, no al de la entrada.
+    std::vector<int> prefixes;
+    std::vector<unsigned char> suffixes;
+    std::vector<unsigned char> firstBytes;
+    std::vector<size_t> lengths;
+    int code = 256;
+
+    // Primer codigo libre despues de las frases del diccionario precargado.
+    int dictionaryCode = 256;
+
+    // Tabla hash abierta (prefijo, byte) -> codigo para el compresor. Una
+    // entrada es valida solo si su marca coincide con la generacion actual,
+    // de modo que vaciarla entre llamadas es O(1). Las frases del diccionario
+    // llevan una marca permanente y sobreviven a cada reinicio.
+    static const unsigned int PERMANENT = ~0u;
+    std::vector<unsigned long long> hashKeys;
+    std::vector<int> hashCodes;
+    std::vector<unsigned int> hashStamps;
+    unsigned int generation = 0;
+    size_t hashMask = 0;
+
+    static unsigned long long phraseKey(int prefix, unsigned char byte) {
+        return (static_cast<unsigned long long>(prefix) << 8) | byte;
+    }
+
+    size_t hashSlot(unsigned long long key) const {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 20) & hashMask;
+    }
+
+    bool isLive(size_t slot) const {
+        return hashStamps[slot] == generation || hashStamps[slot] == PERMANENT;
+    }
+
+    void insertHash(unsigned long long key, int value) {
+        size_t slot = hashSlot(key);
+        while (isLive(slot)) {
+            slot = (slot + 1) & hashMask;
+        }
+        hashStamps[slot] = generation;
+        hashKeys[slot] = key;
+        hashCodes[slot] = value;
+    }
+
+    bool isFull() const {
+        return BOUNDED && static_cast<size_t>(code) == MAX_CODES;
+    }
+
+    // Descarta las frases aprendidas en la llamada anterior; solo cuenta
+    // como reinicio si habia alguna.
+    void resetTable() {
+        if (code > dictionaryCode) {
+            METRIC_ADD("lzw_dictionary_resets_total", 1);
+        }
+        if (prefixes.size() < 256) {
+            prefixes.resize(256);
+            suffixes.resize(256);
+            firstBytes.resize(256);
+            lengths.resize(256);
+            for (int i = 0; i < 256; ++i) {
+                prefixes[i] = -1;
+                suffixes[i] = static_cast<unsigned char>(i);
+                firstBytes[i] = static_cast<unsigned char>(i);
+                lengths[i] = 1;
             }
         }
+        code = dictionaryCode;
+    }
+
+    void growTable() {
+        size_t size = std::min(prefixes.size() * 2, MAX_CODES);
+        prefixes.resize(size);
+        suffixes.resize(size);
+        firstBytes.resize(size);
+        lengths.resize(size);
+    }
+
+    // Duplica la tabla hash y reinserta las frases vivas desde la tabla de
+    // frases: las del diccionario con marca permanente y las de la llamada
+    // actual con la generacion en curso.
+    void growHash() {
+        size_t slots = hashKeys.empty() ? 1024 : hashKeys.size() * 2;
+        hashKeys.assign(slots, 0);
+        hashCodes.assign(slots, 0);
+        hashStamps.assign(slots, 0);
+        hashMask = slots - 1;
 
-        if (!current.empty()) {
-            compressed.push_back(dictionary[current]);
+        unsigned int current = generation;
+        generation = PERMANENT;
+        for (int c = 256; c < dictionaryCode; ++c) {
+            insertHash(phraseKey(prefixes[c], suffixes[c]), c);
         }
+        generation = current;
+        for (int c = dictionaryCode; c < code; ++c) {
+            insertHash(phraseKey(prefixes[c], suffixes[c]), c);
+        }
+    }
 
-        return compressed;
+    void resetHash() {
+        if (hashKeys.empty()) {
+            growHash();
+        }
+        if (++generation == PERMANENT) {
+            for (auto& stamp : hashStamps) {
+                if (stamp != PERMANENT) {
+                    stamp = 0;
+                }
+            }
+            generation = 1;
+        }
     }
 
-    std::string decompress(const std::vector<int>& compressed) {
-        std::unordered_map<int, std::string> dictionary;
-        for (int i = 0; i < 256; ++i) {
-            dictionary[i] = std::string(1, i);
+    void addPhrase(int prefix, unsigned char byte) {
+        if (static_cast<size_t>(code) == prefixes.size()) {
+            growTable();
         }
+        prefixes[code] = prefix;
+        suffixes[code] = byte;
+        firstBytes[code] = firstBytes[prefix];
+        lengths[code] = lengths[prefix] + 1;
+        code++;
+    }
 
-        std::string current = dictionary[compressed[0]];
-        std::string decompressed = current;
-        int code = 256;
+    // Busca (prefijo, byte); si no existe lo agrega (salvo con la tabla
+    // llena) y devuelve -1.
+    int findOrAdd(int prefix, unsigned char byte) {
+        // Factor de carga maximo de 1/2.
+        if (static_cast<size_t>(code - 256 + 1) * 2 > hashKeys.size()) {
+            growHash();
+        }
+        unsigned long long key = phraseKey(prefix, byte);
+        size_t slot = hashSlot(key);
+        while (isLive(slot)) {
+            if (hashKeys[slot] == key) {
+                return hashCodes[slot];
+            }
+            slot = (slot + 1) & hashMask;
+        }
+        if (isFull()) {
+            return -1;
+        }
+        hashStamps[slot] = generation;
+        hashKeys[slot] = key;
+        hashCodes[slot] = code;
+        addPhrase(prefix, byte);
+        return -1;
+    }
 
-        for (size_t i = 1; i < compressed.size(); ++i) {
-            std::string entry;
-            if (dictionary.find(compressed[i]) != dictionary.end()) {
-                entry = dictionary[compressed[i]];
-            } else if (compressed[i] == code) {
-                entry = current + current[0];
-            } else {
+    // Decodifica pidiendo a 'reserve' espacio para cada frase; la frase se
+    // escribe de atras hacia adelante recorriendo la cadena de prefijos.
+    template <typename Reserve>
+    void decode(const Code* compressed, size_t count, Reserve reserve) {
+        if (count == 0) {
+            return;
+        }
+        metrics::PhaseTimer decodeTimer;
+        resetTable();
+
+        int current = -1;
+        for (size_t i = 0; i < count; ++i) {
+            int entry = compressed[i];
+            if (entry < 0 || entry > code || (entry == code && current < 0)) {
                 throw std::runtime_error("Error en la descompresión: código no encontrado.");
             }
+            if (entry == code) {
+                // Caso cScSc: la frase es la anterior mas su primer byte.
+                addPhrase(current, firstBytes[current]);
+                current = -1;
+            }
 
-            decompressed += entry;
-            dictionary[code++] = current + entry[0];
+            char* dest = reserve(lengths[entry]);
+            for (int c = entry; c >= 0; c = prefixes[c]) {
+                dest[lengths[c] - 1] = static_cast<char>(suffixes[c]);
+            }
+
+            if (current >= 0 && !isFull()) {
+                addPhrase(current, firstBytes[entry]);
+            }
             current = entry;
         }
+        METRIC_MAX("lzw_dictionary_size", code);
+        METRIC_ADD("phase_decode_ns_total", decodeTimer.elapsedNanoseconds());
+    }
+
+    // Recorre el texto agregando frases al diccionario; emite el codigo de
+    // cada frase completada si 'out' no es nulo.
+    size_t parse(const char* text, size_t textSize, Code* out) {
+        size_t count = 0;
+        size_t lookups = 0;
+        size_t hits = 0;
+        int current = -1;
+        for (size_t i = 0; i < textSize; ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (current < 0) {
+                current = c;
+                continue;
+            }
+            int next = findOrAdd(current, c);
+            lookups++;
+            if (next < 0) {
+                if (out) {
+                    out[count] = static_cast<Code>(current);
+                }
+                count++;
+                current = c;
+            } else {
+                current = next;
+                hits++;
+            }
+        }
+
+        if (current >= 0) {
+            if (out) {
+                out[count] = static_cast<Code>(current);
+            }
+            count++;
+        }
 
+        // La precarga del diccionario no cuenta como parte de la ejecucion.
+        if (out) {
+            METRIC_ADD("lzw_dictionary_lookups_total", lookups);
+            METRIC_ADD("lzw_dictionary_hits_total", hits);
+            METRIC_ADD("lzw_codes_total", count);
+            METRIC_MAX("lzw_dictionary_size", code);
+        }
+        return count;
+    }
+
+public:
+    // Tamaño por defecto de los diccionarios entrenados.
+    static constexpr size_t DICTIONARY_SIZE = 4096;
+
+    // Precarga la tabla con las frases del diccionario entrenado. El
+    // descompresor debe cargar el mismo diccionario.
+    void loadDictionary(const std::string& dict) {
+        metrics::PhaseTimer modelTimer;
+        code = dictionaryCode = 256;
+        hashKeys.clear();
+        resetTable();
+        resetHash();
+
+        generation = PERMANENT;
+        parse(dict.data(), dict.size(), nullptr);
+        generation = 1;
+        dictionaryCode = code;
+        METRIC_ADD("phase_model_ns_total", modelTimer.elapsedNanoseconds());
+    }
+
+    // Peor caso: un codigo por cada byte de entrada.
+    static size_t compressBound(size_t inputSize) {
+        return inputSize;
+    }
+
+    // Escribe los codigos en el buffer del llamador y devuelve cuantos se
+    // escribieron. El diccionario se reutiliza entre llamadas.
+    size_t compress(const char* text, size_t textSize, Code* out, size_t capacity) {
+        if (textSize > capacity) {
+            throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+        }
+        metrics::PhaseTimer encodeTimer;
+        resetTable();
+        resetHash();
+        size_t count = parse(text, textSize, out);
+        METRIC_ADD("phase_encode_ns_total", encodeTimer.elapsedNanoseconds());
+        return count;
+    }
+
+    // Reconstruye el texto en el buffer del llamador y devuelve cuantos
+    // bytes se escribieron.
+    size_t decompress(const Code* compressed, size_t count, char* out, size_t capacity) {
+        size_t size = 0;
+        decode(compressed, count, [&](size_t length) {
+            if (length > capacity - size) {
+                throw std::runtime_error("Error en la descompresión: buffer de salida insuficiente.");
+            }
+            char* dest = out + size;
+            size += length;
+            return dest;
+        });
+        return size;
+    }
+
+    std::vector<Code> compress(const std::string& text) {
+        std::vector<Code> compressed(compressBound(text.size()));
+        compressed.resize(compress(text.data(), text.size(), compressed.data(), compressed.size()));
+        return compressed;
+    }
+
+    std::string decompress(const std::vector<Code>& compressed) {
+        std::string decompressed;
+        decode(compressed.data(), compressed.size(), [&](size_t length) {
+            size_t size = decompressed.size();
+            decompressed.resize(size + length);
+            return &decompressed[size];
+        });
         return decompressed;
     }
 };
 
-void compressFile(const std::string& inputFileName, const std::string& compressedFileName) {
-    LZWCompression lzw;
+// Formato original: codigos int sin cabecera.
+using LZWCompression = LZWCodec<int>;
+
+METRIC_RATIO("lzw_dictionary_hit_rate", "lzw_dictionary_hits_total", "lzw_dictionary_lookups_total");
+
+// Los archivos de 16 bits empiezan con esta firma; los de 32 bits conservan
+// el formato original sin cabecera. No hay ambiguedad porque el primer
+// codigo de un archivo de 32 bits siempre es menor que 65536.
+const char NARROW_MAGIC[4] = {'L', 'Z', '1', '6'};
+
+template <typename Code>
+void writeCodes(std::ostream& out, const Code* compressed, size_t count) {
+    if (sizeof(Code) < sizeof(int)) {
+        out.write(NARROW_MAGIC, sizeof(NARROW_MAGIC));
+    }
+    out.write(reinterpret_cast<const char*>(compressed), count * sizeof(Code));
+}
+
+template <typename Code>
+std::vector<Code> readCodes(std::istream& in) {
+    std::vector<Code> compressed;
+    Code code;
+    while (in.read(reinterpret_cast<char*>(&code), sizeof(code))) {
+        compressed.push_back(code);
+    }
+    return compressed;
+}
+
+// Descompresor que acepta ambos anchos de codigo y elige el codec segun la
+// firma de cada flujo. Antes de decodificar verifica que el flujo se haya
+// comprimido con el mismo diccionario.
+class LZWDecoder {
+public:
+    explicit LZWDecoder(const std::string& dictionary) : dictionary(dictionary) {
+        narrow.loadDictionary(dictionary);
+        wide.loadDictionary(dictionary);
+    }
+
+    std::string decompress(std::istream& in) {
+        metrics::PhaseTimer readTimer;
+        checkDictionaryId(in, dictionary);
+        if (consumeMagic(in, NARROW_MAGIC)) {
+            std::vector<uint16_t> compressed = readCodes<uint16_t>(in);
+            METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
+            return narrow.decompress(compressed);
+        }
+        std::vector<int> compressed = readCodes<int>(in);
+        METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
+        return wide.decompress(compressed);
+    }
+
+private:
+    std::string dictionary;
+    LZWCodec<uint16_t> narrow;
+    LZWCodec<int> wide;
+};
+
+// Comprime un bloque del lote o del canal asincrono con el contexto y el
+// buffer de codigos del hilo que lo atiende. Cada bloque lleva la marca del
+// diccionario, porque se descomprime por separado.
+template <typename Code>
+std::string compressBlock(LZWCodec<Code>& lzw, std::vector<Code>& codes, const std::string& dictionary, const char* data, size_t size) {
+    codes.resize(LZWCodec<Code>::compressBound(size));
+    size_t count = lzw.compress(data, size, codes.data(), codes.size());
+
+    std::ostringstream payload(std::ios::binary);
+    writeDictionaryId(payload, dictionary);
+    writeCodes(payload, codes.data(), count);
+    return payload.str();
+}
+
+template <typename Code>
+void compressFile(const std::string& inputFileName, const std::string& compressedFileName, const std::string& dictionary) {
+    METRICS_BEGIN_RUN();
+    LZWCodec<Code> lzw;
+    lzw.loadDictionary(dictionary);
+
+    // Los archivos grandes van por bloques, solapando lectura, compresion
+    // y escritura.
+    if (usePipeline(inputFileName)) {
+        std::vector<Code> codes;
+        PipelineStats stats = compressPipelined(inputFileName, compressedFileName, [&](size_t, const char* data, size_t size) {
+            return compressBlock(lzw, codes, dictionary, data, size);
+        });
+        if (stats.ok) {
+            std::cout << "Archivo comprimido en: " << compressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
+    metrics::PhaseTimer readTimer;
     std::ifstream inputFile(inputFileName);
     if (!inputFile.is_open()) {
         std::cerr << "Error: No se pudo abrir el archivo original." << std::endl;
@@ -73,46 +427,64 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
 
     std::string text((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
     inputFile.close();
+    METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::vector<int> compressed = lzw.compress(text);
+    std::vector<Code> compressed = lzw.compress(text);
     auto end = std::chrono::high_resolution_clock::now();
 
+    metrics::PhaseTimer writeTimer;
     std::ofstream compressedFile(compressedFileName, std::ios::binary);
     if (!compressedFile.is_open()) {
         std::cerr << "Error: No se pudo crear el archivo comprimido." << std::endl;
         return;
     }
 
-    for (int code : compressed) {
-        compressedFile.write(reinterpret_cast<const char*>(&code), sizeof(code));
-    }
+    writeDictionaryId(compressedFile, dictionary);
+    writeCodes(compressedFile, compressed.data(), compressed.size());
+    std::streamoff compressedSize = compressedFile.tellp();
     compressedFile.close();
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo comprimido en: " << compressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
-    std::cout << "Tamaño original: " << text.size() << " bytes, Tamaño comprimido: " << compressed.size() * sizeof(int) << " bytes." << std::endl;
+    std::cout << "Tamaño original: " << text.size() << " bytes, Tamaño comprimido: " << compressedSize << " bytes." << std::endl;
 }
 
-void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName) {
-    LZWCompression lzw;
+void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName, const std::string& dictionary) {
+    METRICS_BEGIN_RUN();
+    LZWDecoder lzw(dictionary);
+
+    PipelineStats stats;
+    bool isBlockFile = decompressPipelined(compressedFileName, decompressedFileName, [&](std::istream& block) {
+        return lzw.decompress(block);
+    }, stats);
+    if (isBlockFile) {
+        if (stats.ok) {
+            std::cout << "Archivo descomprimido en: " << decompressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
     std::ifstream compressedFile(compressedFileName, std::ios::binary);
     if (!compressedFile.is_open()) {
         std::cerr << "Error: No se pudo abrir el archivo comprimido." << std::endl;
         return;
     }
 
-    std::vector<int> compressed;
-    int code;
-    while (compressedFile.read(reinterpret_cast<char*>(&code), sizeof(code))) {
-        compressed.push_back(code);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string decompressed;
+    try {
+        decompressed = lzw.decompress(compressedFile);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return;
     }
     compressedFile.close();
-
-    auto start = std::chrono::high_resolution_clock::now();
-    std::string decompressed = lzw.decompress(compressed);
     auto end = std::chrono::high_resolution_clock::now();
 
+    metrics::PhaseTimer writeTimer;
     std::ofstream decompressedFile(decompressedFileName);
     if (!decompressedFile.is_open()) {
         std::cerr << "Error: No se pudo crear el archivo descomprimido." << std::endl;
@@ -121,11 +493,49 @@ void decompressFile(const std::string& compressedFileName, const std::string& de
 
     decompressedFile << decompressed;
     decompressedFile.close();
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo descomprimido en: " << decompressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
 }
 
+template <typename Code>
+void compressBatchFiles(const std::vector<std::string>& inputs, const std::string& outputDir, const std::string& dictionary) {
+    METRICS_BEGIN_RUN();
+    BatchOptions options;
+
+    // Un contexto por hilo, con sus tablas y buffers reutilizables, y un
+    // descompresor por hilo para verificar los bloques con options.verify.
+    std::vector<LZWCodec<Code>> codecs(options.threadCount);
+    std::vector<std::vector<Code>> codeBuffers(options.threadCount);
+    std::vector<LZWDecoder> decoders;
+    for (auto& codec : codecs) {
+        codec.loadDictionary(dictionary);
+        decoders.emplace_back(dictionary);
+    }
+
+    auto stats = compressBatch(inputs, outputDir, [&](size_t worker, const char* data, size_t size) {
+        return compressBlock(codecs[worker], codeBuffers[worker], dictionary, data, size);
+    }, [&](size_t worker, std::istream& payload) {
+        return decoders[worker].decompress(payload);
+    }, options);
+
+    printBatchStats(stats);
+}
+
+// Anchos de codigo disponibles, instanciados en compilacion y elegidos en
+// tiempo de ejecucion desde el menu.
+struct CodeWidth {
+    int bits;
+    void (*compressFile)(const std::string&, const std::string&, const std::string&);
+    void (*compressBatchFiles)(const std::vector<std::string>&, const std::string&, const std::string&);
+};
+
+const CodeWidth CODE_WIDTHS[] = {
+    {16, &compressFile<uint16_t>, &compressBatchFiles<uint16_t>},
+    {32, &compressFile<int>, &compressBatchFiles<int>},
+};
+
 int main() {
 
       system("chcp 65001");
@@ -136,12 +546,20 @@ int main() {
     std::string inputFileName;
     std::string compressedFileName;
     std::string decompressedFileName;
+    std::string dictionaryFileName;
+    std::string dictionary;
+    const CodeWidth* codeWidth = &CODE_WIDTHS[1];
 
     while (true) {
         std::cout << "\n--- Menu LZW Compression ---" << std::endl;
         std::cout << "1. Comprimir archivo" << std::endl;
         std::cout << "2. Descomprimir archivo" << std::endl;
-        std::cout << "3. Salir" << std::endl;
+        std::cout << "3. Entrenar diccionario" << std::endl;
+        std::cout << "4. Cargar diccionario" << std::endl;
+        std::cout << "5. Comprimir lote (directorios o archivos)" << std::endl;
+        std::cout << "6. Exportar metricas (.json o .prom)" << std::endl;
+        std::cout << "7. Cambiar ancho de codigo (actual: " << codeWidth->bits << " bits)" << std::endl;
+        std::cout << "8. Salir" << std::endl;
         std::cout << "Seleccione una opcion: ";
 
         int choice;
@@ -152,14 +570,49 @@ int main() {
             std::cin >> inputFileName;
             std::cout << "Ingrese el nombre del archivo comprimido de salida: ";
             std::cin >> compressedFileName;
-            compressFile(inputFileName, compressedFileName);
+            codeWidth->compressFile(inputFileName, compressedFileName, dictionary);
         } else if (choice == 2) {
             std::cout << "Ingrese el nombre del archivo comprimido: ";
             std::cin >> compressedFileName;
             std::cout << "Ingrese el nombre del archivo descomprimido de salida: ";
             std::cin >> decompressedFileName;
-            decompressFile(compressedFileName, decompressedFileName);
+            decompressFile(compressedFileName, decompressedFileName, dictionary);
         } else if (choice == 3) {
+            std::vector<std::string> sampleFileNames;
+            std::string sampleFileName;
+            std::cout << "Ingrese los archivos de muestra ('fin' para terminar): ";
+            while (std::cin >> sampleFileName && sampleFileName != "fin") {
+                sampleFileNames.push_back(sampleFileName);
+            }
+            std::cout << "Ingrese el nombre del diccionario de salida: ";
+            std::cin >> dictionaryFileName;
+            trainDictionaryFile(sampleFileNames, dictionaryFileName, LZWCompression::DICTIONARY_SIZE);
+        } else if (choice == 4) {
+            std::cout << "Ingrese el nombre del diccionario (el mismo al comprimir y descomprimir): ";
+            std::cin >> dictionaryFileName;
+            dictionary = loadDictionaryFile(dictionaryFileName);
+            std::cout << "Diccionario cargado: " << dictionary.size() << " bytes." << std::endl;
+        } else if (choice == 5) {
+            std::vector<std::string> inputs;
+            std::string input;
+            std::cout << "Ingrese los directorios o archivos a comprimir ('fin' para terminar): ";
+            while (std::cin >> input && input != "fin") {
+                inputs.push_back(input);
+            }
+            std::cout << "Ingrese el directorio de salida: ";
+            std::cin >> compressedFileName;
+            codeWidth->compressBatchFiles(inputs, compressedFileName, dictionary);
+        } else if (choice == 6) {
+            std::string metricsFileName;
+            std::cout << "Ingrese el nombre del archivo de metricas: ";
+            std::cin >> metricsFileName;
+            exportMetrics(metricsFileName);
+        } else if (choice == 7) {
+            int bits;
+            std::cout << "Ingrese el ancho de codigo (16 o 32): ";
+            std::cin >> bits;
+            codeWidth = &CODE_WIDTHS[bits == 16 ? 0 : 1];
+        } else if (choice == 8) {
             std::cout << "Saliendo..." << std::endl;
             break;
         } else {
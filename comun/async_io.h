@@ -0,0 +1,452 @@
+#pragma once
+
+// E/S asincrona para archivos grandes: un hilo lee el bloque N+1 y otro
+// escribe el N-1 mientras el hilo del llamador codifica el N, de modo que
+// el tiempo total se acerca al mayor entre E/S y calculo en lugar de su
+// suma. Los bloques circulan por un anillo de buffers alineados que se
+// reutilizan, y la salida es el mismo contenedor por bloques del lote.
+//
+// La lectura usa hilos en todas las plataformas. Compilando con
+// -DDATADOCK_DIRECT_IO, en Linux se lee con O_DIRECT para no pasar por la
+// cache de paginas (si el sistema de archivos no lo admite se lee normal).
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "batch.h"
+#include "magic.h"
+#include "metrics.h"
+
+struct PipelineOptions {
+    size_t blockSize = 4 << 20;
+
+    // Tres buffers alcanzan para tener a la vez un bloque en lectura, uno
+    // en codificacion y uno en escritura.
+    size_t bufferCount = 3;
+
+#ifdef DATADOCK_DIRECT_IO
+    bool directIo = true;
+#else
+    bool directIo = false;
+#endif
+};
+
+struct PipelineStats {
+    bool ok = false;
+    size_t blocks = 0;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    double seconds = 0.0;
+};
+
+namespace pipeline_detail {
+
+// Alineacion que exige O_DIRECT en los sistemas de archivos habituales.
+const size_t ALIGNMENT = 4096;
+
+inline size_t alignUp(size_t size) {
+    return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    ~AlignedBuffer() {
+        release();
+    }
+
+    // Solo reserva si el bloque no cabe; en regimen estable no hay
+    // reservas. Se usa el operator new alineado de C++17 porque
+    // std::aligned_alloc no existe en MinGW ni en MSVC.
+    void reserve(size_t size) {
+        if (size <= bufferCapacity) {
+            return;
+        }
+        release();
+        size_t capacity = alignUp(size);
+        buffer = static_cast<char*>(::operator new(capacity, std::align_val_t{ALIGNMENT}));
+        bufferCapacity = capacity;
+    }
+
+    char* data() {
+        return buffer;
+    }
+
+    size_t capacity() const {
+        return bufferCapacity;
+    }
+
+private:
+    void release() {
+        if (buffer) {
+            ::operator delete(buffer, std::align_val_t{ALIGNMENT});
+        }
+        buffer = nullptr;
+        bufferCapacity = 0;
+    }
+
+    char* buffer = nullptr;
+    size_t bufferCapacity = 0;
+};
+
+// Lectura por posicion de un archivo de entrada.
+class BlockReader {
+public:
+    BlockReader(const std::string& fileName, bool directIo) {
+#if defined(__unix__) || defined(__APPLE__)
+#ifdef O_DIRECT
+        if (directIo) {
+            fd = ::open(fileName.c_str(), O_RDONLY | O_DIRECT);
+            direct = fd >= 0;
+        }
+#endif
+        if (fd < 0) {
+            fd = ::open(fileName.c_str(), O_RDONLY);
+        }
+#else
+        (void)directIo;
+        inFile.open(fileName, std::ios::binary);
+#endif
+    }
+
+    ~BlockReader() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+    }
+
+    bool isOpen() const {
+#if defined(__unix__) || defined(__APPLE__)
+        return fd >= 0;
+#else
+        return inFile.is_open();
+#endif
+    }
+
+    // Con O_DIRECT el desplazamiento y el tamaño pedidos deben estar
+    // alineados, asi que se pide el bloque redondeado hacia arriba; el
+    // buffer ya tiene esa capacidad.
+    size_t read(uint64_t offset, AlignedBuffer& buffer, size_t size) {
+        buffer.reserve(size);
+#if defined(__unix__) || defined(__APPLE__)
+        size_t request = direct ? alignUp(size) : size;
+        size_t done = 0;
+        while (done < size) {
+            ssize_t count = ::pread(fd, buffer.data() + done, request - done, static_cast<off_t>(offset + done));
+            if (count < 0 && direct && done == 0) {
+                // Algunos sistemas de archivos aceptan O_DIRECT al abrir
+                // pero no al leer; se sigue sin el.
+                direct = false;
+                request = size;
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(count);
+        }
+        return std::min(done, size);
+#else
+        inFile.seekg(offset);
+        inFile.read(buffer.data(), size);
+        size_t done = static_cast<size_t>(inFile.gcount());
+        inFile.clear();
+        return done;
+#endif
+    }
+
+private:
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = -1;
+    bool direct = false;
+#else
+    std::ifstream inFile;
+#endif
+};
+
+struct Slot {
+    enum class State { Free, Read, Coded };
+
+    AlignedBuffer input;
+    size_t inputSize = 0;
+    std::string output;
+    State state = State::Free;
+};
+
+// Recorre 'blockCount' bloques por el anillo: 'readBlock' corre en un
+// hilo lector, 'codeBlock' en el hilo del llamador y 'writeBlock' en un
+// hilo escritor. Si una etapa falla se detienen las demas y la excepcion
+// se relanza aqui; compressPipelined y decompressPipelined la atrapan.
+template <typename ReadBlock, typename CodeBlock, typename WriteBlock>
+void runRing(size_t blockCount, size_t bufferCount, ReadBlock readBlock, CodeBlock codeBlock, WriteBlock writeBlock) {
+    std::vector<Slot> slots(std::max<size_t>(1, bufferCount));
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::exception_ptr error;
+    bool failed = false;
+
+    auto waitFor = [&](Slot& slot, Slot::State state) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return failed || slot.state == state; });
+        return !failed;
+    };
+    auto advance = [&](Slot& slot, Slot::State state) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.state = state;
+        }
+        changed.notify_all();
+    };
+    auto fail = [&] {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+        changed.notify_all();
+    };
+
+    std::thread reader([&] {
+        try {
+            for (size_t i = 0; i < blockCount; ++i) {
+                Slot& slot = slots[i % slots.size()];
+                if (!waitFor(slot, Slot::State::Free)) {
+                    return;
+                }
+                metrics::PhaseTimer readTimer;
+                readBlock(i, slot);
+                METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
+                advance(slot, Slot::State::Read);
+            }
+        } catch (...) {
+            fail();
+        }
+    });
+    std::thread writer([&] {
+        try {
+            for (size_t i = 0; i < blockCount; ++i) {
+                Slot& slot = slots[i % slots.size()];
+                if (!waitFor(slot, Slot::State::Coded)) {
+                    return;
+                }
+                metrics::PhaseTimer writeTimer;
+                writeBlock(slot);
+                METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
+                advance(slot, Slot::State::Free);
+            }
+        } catch (...) {
+            fail();
+        }
+    });
+
+    try {
+        for (size_t i = 0; i < blockCount; ++i) {
+            Slot& slot = slots[i % slots.size()];
+            if (!waitFor(slot, Slot::State::Read)) {
+                break;
+            }
+            codeBlock(slot);
+            advance(slot, Slot::State::Coded);
+        }
+    } catch (...) {
+        fail();
+    }
+
+    reader.join();
+    writer.join();
+    METRIC_ADD("pipeline_blocks_total", blockCount);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+// Informa el error de una etapa y borra la salida a medio escribir para
+// que no quede un archivo truncado con apariencia valida.
+inline void discardOutput(std::ofstream& outFile, const std::string& outputFileName, const std::exception& error) {
+    std::cerr << error.what() << std::endl;
+    outFile.close();
+    std::error_code removeError;
+    std::filesystem::remove(outputFileName, removeError);
+}
+
+} // namespace pipeline_detail
+
+// Comprime el archivo por bloques con 'compressBlock' (el mismo del lote,
+// llamado siempre con worker 0) y escribe un contenedor por bloques.
+inline PipelineStats compressPipelined(const std::string& inputFileName, const std::string& outputFileName,
+                                       const BlockCompressor& compressBlock,
+                                       const PipelineOptions& options = PipelineOptions()) {
+    using namespace pipeline_detail;
+    auto start = std::chrono::high_resolution_clock::now();
+    PipelineStats stats;
+
+    std::error_code sizeError;
+    uint64_t size = std::filesystem::file_size(inputFileName, sizeError);
+    BlockReader reader(inputFileName, options.directIo);
+    if (sizeError || !reader.isOpen()) {
+        std::cerr << "Error: No se pudo abrir el archivo original." << std::endl;
+        return stats;
+    }
+    std::ofstream outFile(outputFileName, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: No se pudo crear el archivo comprimido." << std::endl;
+        return stats;
+    }
+
+    // Con O_DIRECT cada bloque debe empezar en un desplazamiento alineado.
+    size_t blockSize = alignUp(std::max<size_t>(1, options.blockSize));
+    uint64_t blockCount = std::max<uint64_t>(1, (size + blockSize - 1) / blockSize);
+    outFile.write(BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    outFile.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+    stats.outputBytes = sizeof(BLOCK_MAGIC) + sizeof(blockCount);
+
+    try {
+        runRing(blockCount, options.bufferCount,
+            [&](size_t index, Slot& slot) {
+                uint64_t offset = index * static_cast<uint64_t>(blockSize);
+                size_t length = static_cast<size_t>(std::min<uint64_t>(blockSize, size - offset));
+                slot.inputSize = reader.read(offset, slot.input, length);
+                if (slot.inputSize != length) {
+                    throw std::runtime_error("Error: No se pudo leer " + inputFileName);
+                }
+            },
+            [&](Slot& slot) {
+                slot.output = compressBlock(0, slot.input.data(), slot.inputSize);
+            },
+            [&](Slot& slot) {
+                uint64_t payloadSize = slot.output.size();
+                outFile.write(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+                outFile.write(slot.output.data(), slot.output.size());
+                if (!outFile) {
+                    throw std::runtime_error("Error: No se pudo escribir " + outputFileName);
+                }
+                stats.outputBytes += sizeof(payloadSize) + slot.output.size();
+            });
+    } catch (const std::exception& e) {
+        discardOutput(outFile, outputFileName, e);
+        return stats;
+    }
+    outFile.close();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.ok = true;
+    stats.blocks = blockCount;
+    stats.inputBytes = size;
+    stats.seconds = std::chrono::duration<double>(end - start).count();
+    return stats;
+}
+
+// Si el archivo es un contenedor por bloques lo descomprime con
+// 'decompressBlock', escribiendo cada bloque en cuanto esta listo, y
+// devuelve true (stats.ok indica si se completo). Si no lo es devuelve
+// false para que el programa use su formato de siempre.
+template <typename DecompressBlock>
+bool decompressPipelined(const std::string& inputFileName, const std::string& outputFileName,
+                         DecompressBlock decompressBlock, PipelineStats& stats,
+                         const PipelineOptions& options = PipelineOptions()) {
+    using namespace pipeline_detail;
+    auto start = std::chrono::high_resolution_clock::now();
+    stats = PipelineStats();
+
+    std::ifstream inFile(inputFileName, std::ios::binary);
+    if (!inFile.is_open() || !consumeMagic(inFile, BLOCK_MAGIC)) {
+        return false;
+    }
+    std::ofstream outFile(outputFileName, std::ios::binary);
+    if (!outFile.is_open()) {
+        std::cerr << "Error: No se pudo crear el archivo descomprimido." << std::endl;
+        return true;
+    }
+
+    // El tamaño del archivo acota cada bloque antes de reservar su buffer.
+    inFile.seekg(0, std::ios::end);
+    uint64_t inputSize = static_cast<uint64_t>(inFile.tellg());
+    inFile.seekg(sizeof(BLOCK_MAGIC));
+    uint64_t blockCount = 0;
+    inFile.read(reinterpret_cast<char*>(&blockCount), sizeof(blockCount));
+    if (!inFile) {
+        discardOutput(outFile, outputFileName, std::runtime_error("Error: contenedor por bloques truncado."));
+        return true;
+    }
+    stats.inputBytes = sizeof(BLOCK_MAGIC) + sizeof(blockCount);
+
+    try {
+        runRing(blockCount, options.bufferCount,
+            [&](size_t, Slot& slot) {
+                uint64_t payloadSize = 0;
+                inFile.read(reinterpret_cast<char*>(&payloadSize), sizeof(payloadSize));
+                if (!inFile || payloadSize > inputSize - stats.inputBytes - sizeof(payloadSize)) {
+                    throw std::runtime_error("Error: contenedor por bloques truncado.");
+                }
+                slot.input.reserve(payloadSize);
+                inFile.read(slot.input.data(), payloadSize);
+                if (!inFile) {
+                    throw std::runtime_error("Error: contenedor por bloques truncado.");
+                }
+                slot.inputSize = payloadSize;
+                stats.inputBytes += sizeof(payloadSize) + payloadSize;
+            },
+            [&](Slot& slot) {
+                MemoryStreamBuffer buffer(slot.input.data(), slot.inputSize);
+                std::istream block(&buffer);
+                slot.output = decompressBlock(block);
+            },
+            [&](Slot& slot) {
+                outFile.write(slot.output.data(), slot.output.size());
+                if (!outFile) {
+                    throw std::runtime_error("Error: No se pudo escribir " + outputFileName);
+                }
+                stats.outputBytes += slot.output.size();
+            });
+    } catch (const std::exception& e) {
+        discardOutput(outFile, outputFileName, e);
+        return true;
+    }
+    outFile.close();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.ok = true;
+    stats.blocks = blockCount;
+    stats.seconds = std::chrono::duration<double>(end - start).count();
+    return true;
+}
+
+// Los archivos que no caben en un bloque pasan por el canal asincrono; los
+// demas conservan el formato de un solo flujo.
+inline bool usePipeline(const std::string& inputFileName, const PipelineOptions& options = PipelineOptions()) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(inputFileName, error);
+    return !error && size > options.blockSize;
+}
+
+inline void printPipelineStats(const PipelineStats& stats) {
+    double megabytes = std::max(stats.inputBytes, stats.outputBytes) / (1024.0 * 1024.0);
+    std::cout << "Entrada: " << stats.inputBytes << " bytes, Salida: " << stats.outputBytes << " bytes, "
+              << stats.blocks << " bloques." << std::endl;
+    std::cout << "Tiempo: " << static_cast<long long>(stats.seconds * 1000) << " ms ("
+              << (stats.seconds > 0 ? megabytes / stats.seconds : 0.0) << " MB/s)" << std::endl;
+}
@@ -0,0 +1,516 @@
+#pragma once
+
+// Compresion por lotes compartida por LZ77, LZW y Shannon-Fano: recorre
+// directorios o listas de archivos, parte los archivos grandes en bloques,
+// agrupa los pequeños y los comprime en un pool de hilos con robo de tareas.
+// Cada programa aporta las funciones que comprimen y descomprimen un bloque
+// con su codec.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <streambuf>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "magic.h"
+#include "metrics.h"
+
+// Contenedor por bloques: "DDB1", cantidad de bloques y, por cada bloque, su
+// tamaño seguido de los datos en el formato propio del codec.
+const char BLOCK_MAGIC[4] = {'D', 'D', 'B', '1'};
+
+// Flujo de lectura sobre un buffer ya cargado, para entregar cada bloque
+// al codec sin copiarlo.
+class MemoryStreamBuffer : public std::streambuf {
+public:
+    MemoryStreamBuffer(char* data, size_t size) {
+        setg(data, data, data + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+        char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+        if (offset < eback() - base || offset > egptr() - base) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), base + offset, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode mode) override {
+        return seekoff(off_type(position), std::ios_base::beg, mode);
+    }
+};
+
+// Pool de hilos con una cola por hilo. Cada hilo atiende su cola por el
+// frente y, cuando se vacia, roba tareas por el final de las demas.
+class WorkStealingPool {
+public:
+    using Task = std::function<void(size_t worker)>;
+
+    explicit WorkStealingPool(size_t threadCount) {
+        threadCount = std::max<size_t>(1, threadCount);
+        for (size_t i = 0; i < threadCount; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (size_t i = 0; i < threadCount; ++i) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~WorkStealingPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    void submit(Task task) {
+        size_t index = nextQueue++ % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued++;
+            pending++;
+        }
+        wakeUp.notify_one();
+    }
+
+    // Espera a que terminen todas las tareas enviadas.
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};
+
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable allDone;
+    size_t queued = 0;
+    size_t pending = 0;
+    bool stopping = false;
+
+    bool pop(size_t worker, Task& task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            Queue& queue = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (i == 0) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            } else {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void run(size_t worker) {
+        while (true) {
+            Task task;
+            if (pop(worker, task)) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    queued--;
+                }
+                task(worker);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) {
+                    allDone.notify_all();
+                }
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) {
+                return;
+            }
+        }
+    }
+};
+
+// Limita los bytes en vuelo: los bloques leidos y sus datos comprimidos
+// hasta que se escriben. Un bloque mayor que el limite se admite solo
+// cuando no hay nada mas en vuelo.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(size_t limit) : limit(limit) {}
+
+    void acquire(size_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex);
+        released.wait(lock, [&] { return used == 0 || used + bytes <= limit; });
+        used += bytes;
+    }
+
+    // Suma sin esperar. Los hilos del pool cargan asi los datos que
+    // producen: si esperaran, podrian bloquearse por memoria que solo otro
+    // hilo del pool libera. El exceso frena los envios siguientes.
+    void charge(size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        used += bytes;
+    }
+
+    void release(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            used -= bytes;
+        }
+        released.notify_all();
+    }
+
+private:
+    size_t limit;
+    size_t used = 0;
+    std::mutex mutex;
+    std::condition_variable released;
+};
+
+struct BatchOptions {
+    size_t blockSize = 4 << 20;
+
+    // Cubre los bloques en vuelo. Aparte, cada hilo conserva un conjunto de
+    // trabajo que no depende de la cantidad de archivos: el buffer de
+    // lectura, la copia descomprimida si se verifica (un bloque cada uno) y
+    // los buffers de su codec, proporcionales al bloque.
+    size_t memoryLimit = 256 << 20;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::string extension = ".compressed";
+
+    // Descomprime cada bloque apenas se comprime y lo compara con la
+    // entrada. Casi duplica el trabajo por bloque, asi que solo se activa
+    // a pedido o al compilar con -DDATADOCK_VERIFY_BATCH.
+#ifdef DATADOCK_VERIFY_BATCH
+    bool verify = true;
+#else
+    bool verify = false;
+#endif
+};
+
+struct BatchStats {
+    size_t files = 0;
+    size_t blocks = 0;
+    size_t failedFiles = 0;
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    double seconds = 0.0;
+    size_t threads = 0;
+};
+
+// Comprime un bloque con el codec del programa; 'worker' identifica el hilo
+// para que cada uno reutilice su propio contexto.
+using BlockCompressor = std::function<std::string(size_t worker, const char* data, size_t size)>;
+
+// Descomprime un bloque comprimido por el BlockCompressor del mismo
+// programa, con el contexto del hilo 'worker'.
+using BlockDecompressor = std::function<std::string(size_t worker, std::istream& payload)>;
+
+namespace batch_detail {
+
+struct FileJob {
+    std::filesystem::path input;
+    std::filesystem::path output;
+    std::vector<size_t> blockSizes;
+
+    // Los bloques pueden terminar en cualquier orden; se escriben en orden
+    // a medida que se completan los anteriores.
+    std::mutex mutex;
+    std::ofstream outFile;
+    std::vector<std::string> payloads;
+    std::vector<bool> ready;
+    size_t nextToWrite = 0;
+    uint64_t writtenBytes = 0;
+    bool failed = false;
+};
+
+struct BlockTask {
+    FileJob* file;
+    size_t index;
+    uint64_t offset;
+    size_t size;
+};
+
+// Dos entradas con el mismo nombre (c1/a.txt y c2/a.txt) irian a la misma
+// salida; las siguientes reciben un sufijo numerico en lugar de pisarla.
+inline void addJob(const std::filesystem::path& input, const std::filesystem::path& output,
+                   const std::string& extension, std::set<std::filesystem::path>& outputs,
+                   std::vector<std::unique_ptr<FileJob>>& jobs) {
+    auto job = std::make_unique<FileJob>();
+    job->input = input;
+    job->output = output;
+    job->output += extension;
+    bool renamed = false;
+    for (int suffix = 2; !outputs.insert(job->output).second; ++suffix) {
+        job->output = output;
+        job->output += "_" + std::to_string(suffix) + extension;
+        renamed = true;
+    }
+    if (renamed) {
+        std::cerr << "Aviso: " << input.string() << " se guarda como " << job->output.string()
+                  << " para no pisar otra salida." << std::endl;
+    }
+    jobs.push_back(std::move(job));
+}
+
+inline void collectFiles(const std::vector<std::string>& inputs, const std::string& outputDir,
+                         const std::string& extension, std::vector<std::unique_ptr<FileJob>>& jobs) {
+    namespace fs = std::filesystem;
+    std::set<fs::path> outputs;
+    for (const auto& input : inputs) {
+        fs::path inputPath(input);
+        std::error_code error;
+        if (fs::is_directory(inputPath, error)) {
+            fs::path base = inputPath.filename().empty() ? inputPath.parent_path().filename() : inputPath.filename();
+            fs::recursive_directory_iterator it(inputPath, error), end;
+            for (; !error && it != end; it.increment(error)) {
+                if (it->is_regular_file(error)) {
+                    fs::path relative = fs::relative(it->path(), inputPath, error);
+                    if (!error) {
+                        addJob(it->path(), fs::path(outputDir) / base / relative, extension, outputs, jobs);
+                    }
+                }
+            }
+            if (error) {
+                std::cerr << "Error: No se pudo recorrer " << input << ": " << error.message() << std::endl;
+            }
+        } else if (fs::is_regular_file(inputPath, error)) {
+            addJob(inputPath, fs::path(outputDir) / inputPath.filename(), extension, outputs, jobs);
+        } else {
+            std::cerr << "Error: No se encontro " << input << std::endl;
+        }
+    }
+}
+
+// Crea la salida al escribir el primer bloque. Un error al crearla o al
+// escribir marca el archivo como fallido; solo se cuentan los bytes que
+// llegaron a escribirse.
+inline void writePayload(FileJob& file, const std::string& payload) {
+    if (!file.outFile.is_open()) {
+        std::error_code error;
+        std::filesystem::create_directories(file.output.parent_path(), error);
+        file.outFile.open(file.output, std::ios::binary);
+        if (!file.outFile.is_open()) {
+            std::cerr << "Error: No se pudo crear " << file.output.string() << std::endl;
+            file.failed = true;
+            return;
+        }
+        uint64_t blockCount = file.blockSizes.size();
+        file.outFile.write(BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+        file.outFile.write(reinterpret_cast<const char*>(&blockCount), sizeof(blockCount));
+        file.writtenBytes += sizeof(BLOCK_MAGIC) + sizeof(blockCount);
+    }
+    uint64_t payloadSize = payload.size();
+    file.outFile.write(reinterpret_cast<const char*>(&payloadSize), sizeof(payloadSize));
+    file.outFile.write(payload.data(), payload.size());
+    if (!file.outFile) {
+        std::cerr << "Error: No se pudo escribir " << file.output.string() << std::endl;
+        file.failed = true;
+        return;
+    }
+    file.writtenBytes += sizeof(payloadSize) + payload.size();
+}
+
+// Escribe, en orden, los bloques ya terminados y libera su memoria; el
+// bloque leido y sus datos comprimidos cuentan en el presupuesto hasta
+// entonces.
+inline void completeBlock(FileJob& file, size_t index, std::string payload, bool failed, MemoryBudget& budget) {
+    std::lock_guard<std::mutex> lock(file.mutex);
+    budget.charge(payload.size());
+    file.payloads[index] = std::move(payload);
+    file.ready[index] = true;
+    file.failed = file.failed || failed;
+
+    while (file.nextToWrite < file.blockSizes.size() && file.ready[file.nextToWrite]) {
+        std::string& current = file.payloads[file.nextToWrite];
+        if (!file.failed) {
+            metrics::PhaseTimer writeTimer;
+            writePayload(file, current);
+            METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
+        }
+        size_t payloadSize = current.size();
+        std::string().swap(current);
+        budget.release(file.blockSizes[file.nextToWrite] + payloadSize);
+        file.nextToWrite++;
+    }
+
+    if ((file.failed || file.nextToWrite == file.blockSizes.size()) && file.outFile.is_open()) {
+        file.outFile.close();
+        if (!file.outFile && !file.failed) {
+            std::cerr << "Error: No se pudo escribir " << file.output.string() << std::endl;
+            file.failed = true;
+        }
+    }
+}
+
+} // namespace batch_detail
+
+// Comprime cada archivo de 'inputs' (archivos o directorios, recorridos
+// recursivamente) en 'outputDir', conservando la estructura de carpetas.
+// Con options.verify cada bloque se descomprime con 'decompressBlock' apenas
+// se comprime; si no devuelve los mismos bytes el archivo se marca como
+// fallido y no se deja una salida que perderia datos.
+inline BatchStats compressBatch(const std::vector<std::string>& inputs, const std::string& outputDir,
+                                const BlockCompressor& compressBlock, const BlockDecompressor& decompressBlock,
+                                const BatchOptions& options = BatchOptions()) {
+    using namespace batch_detail;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::unique_ptr<FileJob>> jobs;
+    collectFiles(inputs, outputDir, options.extension, jobs);
+
+    // Los archivos grandes se parten en bloques y los pequeños se agrupan
+    // hasta llenar un bloque, para que todas las tareas pesen parecido.
+    std::vector<std::vector<BlockTask>> groups(1);
+    size_t groupBytes = 0;
+    BatchStats stats;
+    for (auto& job : jobs) {
+        std::error_code error;
+        uint64_t size = std::filesystem::file_size(job->input, error);
+        if (error) {
+            std::cerr << "Error: No se pudo leer " << job->input.string() << std::endl;
+            job->failed = true;
+            continue;
+        }
+        for (uint64_t offset = 0; offset < size; offset += options.blockSize) {
+            job->blockSizes.push_back(static_cast<size_t>(std::min<uint64_t>(options.blockSize, size - offset)));
+        }
+        if (job->blockSizes.empty()) {
+            job->blockSizes.push_back(0);
+        }
+        job->payloads.resize(job->blockSizes.size());
+        job->ready.resize(job->blockSizes.size());
+
+        stats.files++;
+        stats.blocks += job->blockSizes.size();
+        stats.inputBytes += size;
+
+        for (size_t i = 0; i < job->blockSizes.size(); ++i) {
+            size_t blockSize = job->blockSizes[i];
+            if (groupBytes > 0 && groupBytes + blockSize > options.blockSize) {
+                groups.emplace_back();
+                groupBytes = 0;
+            }
+            groups.back().push_back({job.get(), i, i * static_cast<uint64_t>(options.blockSize), blockSize});
+            groupBytes += blockSize;
+        }
+    }
+
+    MemoryBudget budget(options.memoryLimit);
+    {
+        WorkStealingPool pool(options.threadCount);
+        stats.threads = pool.size();
+        for (auto& group : groups) {
+            if (group.empty()) {
+                continue;
+            }
+            size_t bytes = 0;
+            for (const auto& task : group) {
+                bytes += task.size;
+            }
+            // Se reserva antes de enviar, en orden, para que los bloques
+            // previos de cada archivo ya esten en el pool.
+            budget.acquire(bytes);
+            pool.submit([&group, &compressBlock, &decompressBlock, &budget, &options](size_t worker) {
+                std::vector<char> buffer;
+                for (const auto& task : group) {
+                    std::string payload;
+                    bool failed = false;
+                    try {
+                        metrics::PhaseTimer readTimer;
+                        buffer.resize(task.size);
+                        std::ifstream inFile(task.file->input, std::ios::binary);
+                        inFile.seekg(task.offset);
+                        inFile.read(buffer.data(), task.size);
+                        if (!inFile) {
+                            throw std::runtime_error("Error: No se pudo leer " + task.file->input.string());
+                        }
+                        METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
+                        payload = compressBlock(worker, buffer.data(), task.size);
+
+                        if (options.verify) {
+                            metrics::PhaseTimer verifyTimer;
+                            MemoryStreamBuffer stream(&payload[0], payload.size());
+                            std::istream block(&stream);
+                            std::string decoded = decompressBlock(worker, block);
+                            if (decoded.size() != task.size || !std::equal(decoded.begin(), decoded.end(), buffer.begin())) {
+                                throw std::runtime_error("Error: el bloque " + std::to_string(task.index) + " de " +
+                                                         task.file->input.string() + " no se recupera al descomprimir.");
+                            }
+                            METRIC_ADD("phase_verify_ns_total", verifyTimer.elapsedNanoseconds());
+                        }
+                    } catch (const std::exception& e) {
+                        std::cerr << e.what() << std::endl;
+                        failed = true;
+                    }
+                    completeBlock(*task.file, task.index, std::move(payload), failed, budget);
+                }
+            });
+        }
+        pool.wait();
+    }
+
+    for (const auto& job : jobs) {
+        if (job->failed) {
+            stats.failedFiles++;
+            std::error_code error;
+            std::filesystem::remove(job->output, error);
+        } else {
+            stats.outputBytes += job->writtenBytes;
+        }
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.seconds = std::chrono::duration<double>(end - start).count();
+    return stats;
+}
+
+inline void printBatchStats(const BatchStats& stats) {
+    double megabytes = stats.inputBytes / (1024.0 * 1024.0);
+    std::cout << "Lote comprimido: " << stats.files << " archivos, " << stats.blocks << " bloques, "
+              << stats.threads << " hilos" << std::endl;
+    std::cout << "Tamaño original: " << stats.inputBytes << " bytes, Tamaño comprimido: "
+              << stats.outputBytes << " bytes." << std::endl;
+    std::cout << "Tiempo: " << static_cast<long long>(stats.seconds * 1000) << " ms ("
+              << (stats.seconds > 0 ? megabytes / stats.seconds : 0.0) << " MB/s)" << std::endl;
+    if (stats.failedFiles > 0) {
+        std::cerr << "Archivos con error: " << stats.failedFiles << std::endl;
+    }
+}
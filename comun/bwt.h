@@ -0,0 +1,413 @@
+#pragma once
+
+// Etapa opcional de transformacion por bloques para los codificadores de
+// orden 0: Burrows-Wheeler, move-to-front y codificacion de corridas de
+// ceros. El resultado esta dominado por ceros y simbolos pequeños, que un
+// codigo de orden 0 comprime mucho mejor que el texto original.
+//
+// Formato: cantidad de bloques y, por cada bloque, el indice primario, el
+// tamaño original y el tamaño codificado seguidos de los datos. Los bloques
+// son independientes y se transforman en paralelo.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "batch.h"
+#include "metrics.h"
+
+namespace bwt {
+
+// Los programas marcan con esta firma los archivos que pasaron por la etapa.
+const char MAGIC[4] = {'B', 'W', 'T', '1'};
+
+const size_t DEFAULT_BLOCK_SIZE = 8 << 20;
+const size_t MAX_BLOCK_SIZE = 64 << 20;
+
+namespace detail {
+
+// Arreglo de sufijos por SA-IS en tiempo lineal. 'text' tiene simbolos en
+// [0, upper]; los sufijos que son prefijo de otro van primero, como si el
+// texto terminara en un centinela menor que todo el alfabeto.
+template <typename Symbol>
+void suffixArray(const Symbol* text, int n, int upper, int* sa) {
+    if (n == 0) {
+        return;
+    }
+    if (n == 1) {
+        sa[0] = 0;
+        return;
+    }
+    if (n == 2) {
+        sa[0] = text[0] < text[1] ? 0 : 1;
+        sa[1] = 1 - sa[0];
+        return;
+    }
+
+    // Tipo de cada sufijo: S si es menor que el siguiente, L si es mayor.
+    std::vector<bool> isS(n);
+    for (int i = n - 2; i >= 0; --i) {
+        isS[i] = text[i] == text[i + 1] ? isS[i + 1] : text[i] < text[i + 1];
+    }
+
+    // Inicio de la zona L y de la zona S de cada cubeta.
+    std::vector<int> startL(upper + 2), startS(upper + 1);
+    for (int i = 0; i < n; ++i) {
+        if (isS[i]) {
+            startL[text[i] + 1]++;
+        } else {
+            startS[text[i]]++;
+        }
+    }
+    for (int c = 0; c <= upper; ++c) {
+        startS[c] += startL[c];
+        startL[c + 1] += startS[c];
+    }
+
+    std::vector<int> bucket(upper + 2);
+    auto induce = [&](const std::vector<int>& lms) {
+        std::fill(sa, sa + n, -1);
+        std::copy(startS.begin(), startS.end(), bucket.begin());
+        for (int pos : lms) {
+            sa[bucket[text[pos]]++] = pos;
+        }
+        std::copy(startL.begin(), startL.end(), bucket.begin());
+        sa[bucket[text[n - 1]]++] = n - 1;
+        for (int i = 0; i < n; ++i) {
+            int pos = sa[i];
+            if (pos >= 1 && !isS[pos - 1]) {
+                sa[bucket[text[pos - 1]]++] = pos - 1;
+            }
+        }
+        std::copy(startL.begin(), startL.end(), bucket.begin());
+        for (int i = n - 1; i >= 0; --i) {
+            int pos = sa[i];
+            if (pos >= 1 && isS[pos - 1]) {
+                sa[--bucket[text[pos - 1] + 1]] = pos - 1;
+            }
+        }
+    };
+
+    // Posiciones LMS (una S precedida por una L), en orden de texto.
+    std::vector<int> lmsIndex(n, -1);
+    std::vector<int> lms;
+    for (int i = 1; i < n; ++i) {
+        if (!isS[i - 1] && isS[i]) {
+            lmsIndex[i] = static_cast<int>(lms.size());
+            lms.push_back(i);
+        }
+    }
+    int m = static_cast<int>(lms.size());
+
+    induce(lms);
+    if (m == 0) {
+        return;
+    }
+
+    // Nombra las subcadenas LMS ya ordenadas y, si se repiten nombres,
+    // ordena recursivamente el texto reducido.
+    std::vector<int> sortedLms;
+    sortedLms.reserve(m);
+    for (int i = 0; i < n; ++i) {
+        if (lmsIndex[sa[i]] >= 0) {
+            sortedLms.push_back(sa[i]);
+        }
+    }
+    std::vector<int> reduced(m);
+    int names = 0;
+    reduced[lmsIndex[sortedLms[0]]] = 0;
+    for (int i = 1; i < m; ++i) {
+        int left = sortedLms[i - 1];
+        int right = sortedLms[i];
+        int endLeft = lmsIndex[left] + 1 < m ? lms[lmsIndex[left] + 1] : n;
+        int endRight = lmsIndex[right] + 1 < m ? lms[lmsIndex[right] + 1] : n;
+        bool same = endLeft - left == endRight - right;
+        if (same) {
+            while (left < endLeft && text[left] == text[right]) {
+                left++;
+                right++;
+            }
+            same = left < n && right < n && text[left] == text[right];
+        }
+        if (!same) {
+            names++;
+        }
+        reduced[lmsIndex[sortedLms[i]]] = names;
+    }
+
+    std::vector<int> reducedSa(m);
+    suffixArray(reduced.data(), m, names, reducedSa.data());
+    for (int i = 0; i < m; ++i) {
+        sortedLms[i] = lms[reducedSa[i]];
+    }
+    induce(sortedLms);
+}
+
+// BWT con centinela implicito: la fila del centinela no se emite y su
+// posicion queda en 'primary'.
+inline void forward(const unsigned char* text, size_t size, unsigned char* out, uint64_t& primary) {
+    primary = 0;
+    if (size == 0) {
+        return;
+    }
+    std::vector<int> sa(size);
+    suffixArray(text, static_cast<int>(size), 255, sa.data());
+
+    // La fila 0 es el sufijo vacio, precedido por el ultimo byte.
+    size_t written = 0;
+    out[written++] = text[size - 1];
+    for (size_t i = 0; i < size; ++i) {
+        if (sa[i] == 0) {
+            primary = i + 1;
+        } else {
+            out[written++] = text[sa[i] - 1];
+        }
+    }
+}
+
+// Inversa por la correspondencia LF: recorre el texto de atras hacia
+// adelante partiendo de la fila del sufijo vacio.
+inline void inverse(const unsigned char* last, size_t size, uint64_t primary, unsigned char* out) {
+    if (size == 0) {
+        return;
+    }
+    if (primary == 0 || primary > size) {
+        throw std::runtime_error("Error en la descompresión: indice BWT invalido.");
+    }
+
+    size_t counts[257] = {};
+    for (size_t i = 0; i < size; ++i) {
+        counts[last[i] + 1]++;
+    }
+    // El centinela ocupa la primera fila.
+    counts[0] = 1;
+    for (int c = 1; c <= 256; ++c) {
+        counts[c] += counts[c - 1];
+    }
+
+    std::vector<uint32_t> lf(size + 1);
+    lf[primary] = 0;
+    for (size_t row = 0, i = 0; row <= size; ++row) {
+        if (row != primary) {
+            lf[row] = static_cast<uint32_t>(counts[last[i++]]++);
+        }
+    }
+
+    size_t row = 0;
+    for (size_t k = size; k-- > 0;) {
+        out[k] = last[row < primary ? row : row - 1];
+        row = lf[row];
+    }
+}
+
+// Move-to-front seguido de corridas de ceros: cada corrida de 1 a 256
+// ceros se escribe como un 0 y la longitud menos uno.
+inline void mtfEncode(const unsigned char* data, size_t size, std::string& out) {
+    unsigned char order[256];
+    for (int c = 0; c < 256; ++c) {
+        order[c] = static_cast<unsigned char>(c);
+    }
+
+    size_t zeros = 0;
+    auto flushZeros = [&] {
+        while (zeros > 0) {
+            size_t run = std::min<size_t>(zeros, 256);
+            out.push_back('\0');
+            out.push_back(static_cast<char>(run - 1));
+            zeros -= run;
+        }
+    };
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char c = data[i];
+        int rank = 0;
+        while (order[rank] != c) {
+            rank++;
+        }
+        if (rank == 0) {
+            zeros++;
+            continue;
+        }
+        flushZeros();
+        std::memmove(order + 1, order, rank);
+        order[0] = c;
+        out.push_back(static_cast<char>(rank));
+    }
+    flushZeros();
+}
+
+inline void mtfDecode(const unsigned char* data, size_t size, unsigned char* out, size_t capacity) {
+    unsigned char order[256];
+    for (int c = 0; c < 256; ++c) {
+        order[c] = static_cast<unsigned char>(c);
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char rank = data[i];
+        if (rank == 0) {
+            if (i + 1 >= size) {
+                throw std::runtime_error("Error en la descompresión: corrida BWT truncada.");
+            }
+            size_t run = static_cast<size_t>(data[++i]) + 1;
+            if (run > capacity - written) {
+                throw std::runtime_error("Error en la descompresión: bloque BWT mas largo que lo indicado.");
+            }
+            std::memset(out + written, order[0], run);
+            written += run;
+            continue;
+        }
+        if (written == capacity) {
+            throw std::runtime_error("Error en la descompresión: bloque BWT mas largo que lo indicado.");
+        }
+        unsigned char c = order[rank];
+        std::memmove(order + 1, order, rank);
+        order[0] = c;
+        out[written++] = c;
+    }
+    if (written != capacity) {
+        throw std::runtime_error("Error en la descompresión: bloque BWT incompleto.");
+    }
+}
+
+inline void appendU64(std::string& out, uint64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline uint64_t readU64(const std::string& in, size_t& pos) {
+    uint64_t value = 0;
+    if (in.size() - pos < sizeof(value)) {
+        throw std::runtime_error("Error en la descompresión: datos BWT truncados.");
+    }
+    std::memcpy(&value, in.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return value;
+}
+
+// Ejecuta 'work(i)' para cada bloque en un pool; con un solo bloque o un
+// solo hilo lo hace en el hilo actual. Reenvia la primera excepcion.
+template <typename Work>
+void forEachBlock(size_t blockCount, size_t threadCount, Work work) {
+    threadCount = std::min(threadCount, blockCount);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < blockCount; ++i) {
+            work(i);
+        }
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(blockCount);
+    {
+        WorkStealingPool pool(threadCount);
+        for (size_t i = 0; i < blockCount; ++i) {
+            pool.submit([&, i](size_t) {
+                try {
+                    work(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+} // namespace detail
+
+inline size_t defaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Transforma 'data' en bloques de 'blockSize' bytes (como maximo
+// MAX_BLOCK_SIZE), repartidos entre 'threadCount' hilos.
+inline std::string encode(const char* data, size_t size, size_t blockSize = DEFAULT_BLOCK_SIZE,
+                          size_t threadCount = defaultThreadCount()) {
+    metrics::PhaseTimer transformTimer;
+    blockSize = std::max<size_t>(1, std::min(blockSize, MAX_BLOCK_SIZE));
+    size_t blockCount = (size + blockSize - 1) / blockSize;
+
+    std::vector<std::string> blocks(blockCount);
+    detail::forEachBlock(blockCount, threadCount, [&](size_t i) {
+        size_t offset = i * blockSize;
+        size_t length = std::min(blockSize, size - offset);
+        std::vector<unsigned char> last(length);
+        uint64_t primary = 0;
+        detail::forward(reinterpret_cast<const unsigned char*>(data) + offset, length, last.data(), primary);
+
+        std::string& block = blocks[i];
+        detail::appendU64(block, primary);
+        detail::appendU64(block, length);
+        detail::appendU64(block, 0);
+        detail::mtfEncode(last.data(), length, block);
+        uint64_t encodedSize = block.size() - 3 * sizeof(uint64_t);
+        std::memcpy(&block[2 * sizeof(uint64_t)], &encodedSize, sizeof(encodedSize));
+    });
+
+    std::string out;
+    detail::appendU64(out, blockCount);
+    for (auto& block : blocks) {
+        out += block;
+        std::string().swap(block);
+    }
+    METRIC_ADD("bwt_blocks_total", blockCount);
+    METRIC_ADD("phase_transform_ns_total", transformTimer.elapsedNanoseconds());
+    return out;
+}
+
+inline std::string encode(const std::string& data) {
+    return encode(data.data(), data.size());
+}
+
+// Deshace la transformacion; los bloques se invierten en paralelo
+// directamente sobre su lugar en la salida.
+inline std::string decode(const std::string& encoded, size_t threadCount = defaultThreadCount()) {
+    metrics::PhaseTimer transformTimer;
+    struct Block {
+        uint64_t primary;
+        uint64_t outputOffset;
+        uint64_t size;
+        size_t inputOffset;
+        uint64_t encodedSize;
+    };
+
+    size_t pos = 0;
+    uint64_t blockCount = detail::readU64(encoded, pos);
+    std::vector<Block> blocks;
+    uint64_t totalSize = 0;
+    for (uint64_t i = 0; i < blockCount; ++i) {
+        Block block;
+        block.primary = detail::readU64(encoded, pos);
+        block.size = detail::readU64(encoded, pos);
+        block.encodedSize = detail::readU64(encoded, pos);
+        if (block.size > MAX_BLOCK_SIZE || block.encodedSize > encoded.size() - pos) {
+            throw std::runtime_error("Error en la descompresión: bloque BWT invalido.");
+        }
+        block.inputOffset = pos;
+        block.outputOffset = totalSize;
+        pos += block.encodedSize;
+        totalSize += block.size;
+        blocks.push_back(block);
+    }
+
+    std::string out(totalSize, '\0');
+    detail::forEachBlock(blocks.size(), threadCount, [&](size_t i) {
+        const Block& block = blocks[i];
+        std::vector<unsigned char> last(block.size);
+        detail::mtfDecode(reinterpret_cast<const unsigned char*>(encoded.data()) + block.inputOffset,
+                          block.encodedSize, last.data(), last.size());
+        detail::inverse(last.data(), last.size(), block.primary,
+                        reinterpret_cast<unsigned char*>(&out[0]) + block.outputOffset);
+    });
+    METRIC_ADD("phase_transform_ns_total", transformTimer.elapsedNanoseconds());
+    return out;
+}
+
+} // namespace bwt
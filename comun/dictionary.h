@@ -0,0 +1,229 @@
+#pragma once
+
+// Diccionarios entrenados compartidos por LZ77 y LZW: entrenamiento a partir
+// de muestras, lectura del archivo de diccionario y la marca que identifica
+// con que diccionario se comprimio cada flujo.
+//
+// Los flujos comprimidos con diccionario empiezan con "DIC1" y la huella de
+// 64 bits del diccionario; sin diccionario no se escribe nada y el formato
+// no cambia. Asi el descompresor detecta un diccionario equivocado antes de
+// decodificar, en lugar de fallar a mitad del flujo.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "magic.h"
+
+const char DICTIONARY_MAGIC[4] = {'D', 'I', 'C', '1'};
+
+// Huella FNV-1a de 64 bits del contenido del diccionario.
+inline uint64_t dictionaryId(const std::string& dictionary) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : dictionary) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline void writeDictionaryId(std::ostream& out, const std::string& dictionary) {
+    if (dictionary.empty()) {
+        return;
+    }
+    uint64_t id = dictionaryId(dictionary);
+    out.write(DICTIONARY_MAGIC, sizeof(DICTIONARY_MAGIC));
+    out.write(reinterpret_cast<const char*>(&id), sizeof(id));
+}
+
+// Consume la marca si esta presente y lanza un error si el flujo no se
+// comprimio con 'dictionary'. Sin marca deja el flujo como estaba.
+inline void checkDictionaryId(std::istream& in, const std::string& dictionary) {
+    if (consumeMagic(in, DICTIONARY_MAGIC)) {
+        uint64_t id = 0;
+        in.read(reinterpret_cast<char*>(&id), sizeof(id));
+        if (dictionary.empty()) {
+            throw std::runtime_error("Error: el archivo se comprimio con un diccionario; carguelo antes de descomprimir.");
+        }
+        if (!in || id != dictionaryId(dictionary)) {
+            throw std::runtime_error("Error: el archivo se comprimio con otro diccionario.");
+        }
+        return;
+    }
+    if (!dictionary.empty()) {
+        throw std::runtime_error("Error: el archivo se comprimio sin diccionario y hay uno cargado.");
+    }
+}
+
+// Construye un diccionario con los fragmentos que mas se repiten en las
+// muestras, al estilo COVER: cada ventana de WINDOW_SIZE bytes se cuenta por
+// su hash rodante en una tabla de tamaño fijo, y de cada epoca de las muestras
+// se elige el segmento cuyas ventanas distintas suman mas repeticiones. Al
+// elegirlo se ponen a cero las cuentas de sus ventanas, asi la misma frase
+// desplazada unos bytes no vuelve a puntuar y el diccionario guarda
+// contenido distinto. Los segmentos mas valiosos quedan al final, lo mas
+// cerca posible de los datos que se van a comprimir.
+inline std::string trainDictionary(const std::vector<std::string>& samples, size_t maxSize) {
+    const size_t WINDOW_SIZE = 8;
+    const size_t SEGMENT_SIZE = 64;
+    const size_t WINDOWS_PER_SEGMENT = SEGMENT_SIZE - WINDOW_SIZE + 1;
+    const uint64_t HASH_BASE = 1099511628211ull;
+    const uint32_t NO_WINDOW = UINT32_MAX;
+
+    std::string corpus;
+    for (const auto& sample : samples) {
+        corpus += sample;
+    }
+    if (maxSize == 0 || corpus.size() < SEGMENT_SIZE) {
+        return "";
+    }
+
+    // Tabla de cuentas indexada por los bits altos del hash: 4 bytes por
+    // entrada y como mucho 2^22 entradas, sin importar el tamaño del corpus.
+    // Las colisiones solo inflan alguna cuenta.
+    int tableBits = 10;
+    while (tableBits < 22 && (size_t(1) << tableBits) < corpus.size()) {
+        ++tableBits;
+    }
+    std::vector<uint32_t> counts(size_t(1) << tableBits, 0);
+    std::vector<uint32_t> windows(corpus.size(), NO_WINDOW);
+
+    uint64_t outFactor = 1;
+    for (size_t i = 0; i < WINDOW_SIZE; ++i) {
+        outFactor *= HASH_BASE;
+    }
+    size_t sampleStart = 0;
+    for (const auto& sample : samples) {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < sample.size(); ++i) {
+            hash = hash * HASH_BASE + static_cast<unsigned char>(sample[i]);
+            if (i >= WINDOW_SIZE) {
+                hash -= outFactor * static_cast<unsigned char>(sample[i - WINDOW_SIZE]);
+            }
+            if (i + 1 >= WINDOW_SIZE) {
+                uint32_t index = static_cast<uint32_t>((hash * 0x9E3779B97F4A7C15ull) >> (64 - tableBits));
+                windows[sampleStart + i + 1 - WINDOW_SIZE] = index;
+                counts[index]++;
+            }
+        }
+        sampleStart += sample.size();
+    }
+    // Una ventana que aparece una sola vez no aporta nada al diccionario.
+    for (auto& count : counts) {
+        if (count == 1) {
+            count = 0;
+        }
+    }
+
+    struct Segment {
+        uint64_t score;
+        size_t start;
+    };
+    std::vector<Segment> selected;
+    std::vector<uint16_t> active(counts.size(), 0);
+    size_t epochCount = std::max<size_t>(1, std::min(maxSize / SEGMENT_SIZE, corpus.size() / SEGMENT_SIZE));
+    size_t epochSize = corpus.size() / epochCount;
+    size_t total = 0;
+
+    bool progress = true;
+    while (total < maxSize && progress) {
+        progress = false;
+        for (size_t epoch = 0; epoch < epochCount && total < maxSize; ++epoch) {
+            size_t begin = epoch * epochSize;
+            size_t end = epoch + 1 == epochCount ? corpus.size() : begin + epochSize;
+
+            // Ventana deslizante sobre los segmentos que empiezan en la epoca;
+            // 'active' evita contar dos veces una ventana repetida dentro del
+            // mismo segmento.
+            uint64_t score = 0;
+            Segment best = {0, 0};
+            for (size_t w = begin; w + WINDOW_SIZE <= end; ++w) {
+                if (windows[w] != NO_WINDOW && active[windows[w]]++ == 0) {
+                    score += counts[windows[w]];
+                }
+                if (w - begin >= WINDOWS_PER_SEGMENT) {
+                    size_t out = w - WINDOWS_PER_SEGMENT;
+                    if (windows[out] != NO_WINDOW && --active[windows[out]] == 0) {
+                        score -= counts[windows[out]];
+                    }
+                }
+                if (w + 1 - begin >= WINDOWS_PER_SEGMENT && score > best.score) {
+                    best = {score, w + 1 - WINDOWS_PER_SEGMENT};
+                }
+            }
+            for (size_t w = begin; w + WINDOW_SIZE <= end; ++w) {
+                if (windows[w] != NO_WINDOW) {
+                    active[windows[w]] = 0;
+                }
+            }
+            if (best.score == 0) {
+                continue;
+            }
+
+            for (size_t w = best.start; w < best.start + WINDOWS_PER_SEGMENT; ++w) {
+                if (windows[w] != NO_WINDOW) {
+                    counts[windows[w]] = 0;
+                }
+            }
+            selected.push_back(best);
+            total += SEGMENT_SIZE;
+            progress = true;
+        }
+    }
+
+    std::stable_sort(selected.begin(), selected.end(),
+                     [](const Segment& a, const Segment& b) { return a.score < b.score; });
+    std::string dictionary;
+    for (const auto& segment : selected) {
+        dictionary.append(corpus, segment.start, SEGMENT_SIZE);
+    }
+    if (dictionary.size() > maxSize) {
+        dictionary.erase(0, dictionary.size() - maxSize);
+    }
+    return dictionary;
+}
+
+// Entrena con los archivos de muestra y guarda un diccionario de hasta
+// 'maxSize' bytes, el tamaño que aprovecha el codec que lo va a usar.
+inline void trainDictionaryFile(const std::vector<std::string>& sampleFileNames, const std::string& dictionaryFileName,
+                                size_t maxSize) {
+    std::vector<std::string> samples;
+    for (const auto& fileName : sampleFileNames) {
+        std::ifstream sampleFile(fileName, std::ios::binary);
+        if (!sampleFile.is_open()) {
+            std::cerr << "Error: No se pudo abrir la muestra: " << fileName << std::endl;
+            continue;
+        }
+        samples.emplace_back((std::istreambuf_iterator<char>(sampleFile)), std::istreambuf_iterator<char>());
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::string dictionary = trainDictionary(samples, maxSize);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::ofstream dictionaryFile(dictionaryFileName, std::ios::binary);
+    if (!dictionaryFile.is_open()) {
+        std::cerr << "Error: No se pudo crear el diccionario." << std::endl;
+        return;
+    }
+    dictionaryFile.write(dictionary.data(), dictionary.size());
+    dictionaryFile.close();
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "Diccionario guardado en: " << dictionaryFileName << " (" << dictionary.size()
+              << " bytes, Tiempo: " << duration << " ms)" << std::endl;
+}
+
+inline std::string loadDictionaryFile(const std::string& dictionaryFileName) {
+    std::ifstream dictionaryFile(dictionaryFileName, std::ios::binary);
+    if (!dictionaryFile.is_open()) {
+        std::cerr << "Error: No se pudo abrir el diccionario." << std::endl;
+        return "";
+    }
+    return std::string((std::istreambuf_iterator<char>(dictionaryFile)), std::istreambuf_iterator<char>());
+}
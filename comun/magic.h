@@ -0,0 +1,22 @@
+#pragma once
+
+// Firmas de cuatro bytes con que los programas marcan sus flujos: el
+// contenedor por bloques, la etapa BWT, el diccionario y los codigos de
+// 16 bits de LZW.
+
+#include <algorithm>
+#include <istream>
+
+// Consume 'magic' si el flujo sigue con esa firma; si no, deja el flujo
+// como estaba.
+inline bool consumeMagic(std::istream& in, const char (&magic)[4]) {
+    char found[4] = {};
+    std::streampos start = in.tellg();
+    in.read(found, sizeof(found));
+    if (in.gcount() == sizeof(found) && std::equal(found, found + 4, magic)) {
+        return true;
+    }
+    in.clear();
+    in.seekg(start);
+    return false;
+}
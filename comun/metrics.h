@@ -0,0 +1,208 @@
+#pragma once
+
+// Metricas opcionales de los compresores. Se activan compilando con
+// -DDATADOCK_METRICS; sin esa bandera las macros no generan codigo.
+//
+// Los codecs acumulan en variables locales dentro de sus bucles y publican
+// una vez por llamada con METRIC_ADD, asi el costo en el bucle es minimo.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+namespace metrics {
+
+#ifdef DATADOCK_METRICS
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum class Kind { Counter, Gauge, Ratio };
+
+struct Metric {
+    std::string name;
+    Kind kind;
+    std::atomic<uint64_t> value{0};
+
+    // Solo para Kind::Ratio: se calcula al exportar.
+    std::string numerator;
+    std::string denominator;
+};
+
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    Metric& get(const std::string& name, Kind kind) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& metric : metrics) {
+            if (metric.name == name) {
+                return metric;
+            }
+        }
+        metrics.emplace_back();
+        metrics.back().name = name;
+        metrics.back().kind = kind;
+        return metrics.back();
+    }
+
+    void addRatio(const std::string& name, const std::string& numerator, const std::string& denominator) {
+        Metric& metric = get(name, Kind::Ratio);
+        metric.numerator = numerator;
+        metric.denominator = denominator;
+    }
+
+    // Pone a cero todas las metricas al comenzar una ejecucion.
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& metric : metrics) {
+            metric.value = 0;
+        }
+    }
+
+    std::string toJson() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        out << "{";
+        bool first = true;
+        for (const auto& metric : metrics) {
+            out << (first ? "\n" : ",\n") << "  \"" << metric.name << "\": ";
+            if (metric.kind == Kind::Ratio) {
+                out << ratio(metric);
+            } else {
+                out << metric.value.load();
+            }
+            first = false;
+        }
+        out << "\n}\n";
+        return out.str();
+    }
+
+    std::string toPrometheus() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        for (const auto& metric : metrics) {
+            std::string name = "datadock_" + metric.name;
+            out << "# TYPE " << name << (metric.kind == Kind::Counter ? " counter\n" : " gauge\n");
+            out << name << " ";
+            if (metric.kind == Kind::Ratio) {
+                out << ratio(metric);
+            } else {
+                out << metric.value.load();
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<Metric> metrics;
+
+    double ratio(const Metric& metric) const {
+        uint64_t numerator = 0;
+        uint64_t denominator = 0;
+        for (const auto& other : metrics) {
+            if (other.name == metric.numerator) {
+                numerator = other.value;
+            } else if (other.name == metric.denominator) {
+                denominator = other.value;
+            }
+        }
+        return denominator == 0 ? 0.0 : static_cast<double>(numerator) / denominator;
+    }
+};
+
+inline void updateMax(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(std::memory_order_relaxed);
+    while (current < value && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+// Cronometro para medir fases (lectura, modelo, codificacion, escritura).
+// Sin metricas no guarda nada y elapsedNanoseconds devuelve 0.
+class PhaseTimer {
+public:
+#ifdef DATADOCK_METRICS
+    PhaseTimer() : start(std::chrono::steady_clock::now()) {}
+
+    uint64_t elapsedNanoseconds() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+#else
+    uint64_t elapsedNanoseconds() const {
+        return 0;
+    }
+#endif
+};
+
+// Exporta las metricas: formato Prometheus si el archivo termina en
+// ".prom", JSON en cualquier otro caso.
+inline bool exportToFile(const std::string& fileName) {
+    std::ofstream outFile(fileName);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    bool prometheus = fileName.size() >= 5 && fileName.compare(fileName.size() - 5, 5, ".prom") == 0;
+    outFile << (prometheus ? Registry::instance().toPrometheus() : Registry::instance().toJson());
+    return true;
+}
+
+struct RatioRegistration {
+    RatioRegistration(const char* name, const char* numerator, const char* denominator) {
+        Registry::instance().addRatio(name, numerator, denominator);
+    }
+};
+
+} // namespace metrics
+
+#define METRIC_CONCAT_INNER(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT_INNER(a, b)
+
+#ifdef DATADOCK_METRICS
+#define METRIC_ADD(name, amount)                                                                             \
+    do {                                                                                                     \
+        static metrics::Metric& metric_ = metrics::Registry::instance().get(name, metrics::Kind::Counter);   \
+        metric_.value.fetch_add(static_cast<uint64_t>(amount), std::memory_order_relaxed);                   \
+    } while (0)
+#define METRIC_MAX(name, amount)                                                                             \
+    do {                                                                                                     \
+        static metrics::Metric& metric_ = metrics::Registry::instance().get(name, metrics::Kind::Gauge);     \
+        metrics::updateMax(metric_.value, static_cast<uint64_t>(amount));                                    \
+    } while (0)
+#define METRIC_RATIO(name, numerator, denominator) \
+    static metrics::RatioRegistration METRIC_CONCAT(metric_ratio_, __LINE__)(name, numerator, denominator)
+#define METRICS_BEGIN_RUN() metrics::Registry::instance().reset()
+#else
+#define METRIC_ADD(name, amount) ((void)(amount))
+#define METRIC_MAX(name, amount) ((void)(amount))
+#define METRIC_RATIO(name, numerator, denominator) static_assert(true, "")
+#define METRICS_BEGIN_RUN() ((void)0)
+#endif
+
+// Opcion de menu comun: exporta las metricas de la ultima ejecucion.
+inline void exportMetrics(const std::string& fileName) {
+    if (!metrics::enabled) {
+        std::cout << "Metricas desactivadas: compile con -DDATADOCK_METRICS." << std::endl;
+        return;
+    }
+    if (!metrics::exportToFile(fileName)) {
+        std::cerr << "Error: No se pudo escribir el archivo de metricas." << std::endl;
+        return;
+    }
+    std::cout << "Metricas exportadas en: " << fileName << std::endl;
+}
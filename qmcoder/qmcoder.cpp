@@ -3,83 +3,274 @@
 #include <vector>
 #include <map>
 #include <string>
-#include <iomanip>
 #include <chrono>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include "../comun/metrics.h"
 
 class QMCoder {
 private:
-    std::map<char, double> probabilities;
-    std::map<char, std::pair<double, double>> ranges;
+    static constexpr int ALPHABET_SIZE = 256;
+
+    // Tablas indexadas por byte que se reutilizan entre llamadas; los rangos
+    // se acumulan en el orden de 'char' con signo, el mismo que usaban los
+    // archivos ya generados.
+    std::array<double, ALPHABET_SIZE> probabilities{};
+    std::array<double, ALPHABET_SIZE> rangeLow{};
+    std::array<double, ALPHABET_SIZE> rangeHigh{};
+    std::array<bool, ALPHABET_SIZE> present{};
+
+    // Simbolos presentes en el orden de los rangos; el decodificador solo
+    // recorre estos en lugar del alfabeto completo.
+    std::array<unsigned char, ALPHABET_SIZE> symbols{};
+    int symbolCount = 0;
+
+    static unsigned char symbolAt(int index) {
+        return static_cast<unsigned char>(static_cast<char>(index - 128));
+    }
 
-    void calculateProbabilities(const std::string& text) {
-        std::map<char, int> frequency;
-        for (char c : text) {
-            frequency[c]++;
+    void calculateProbabilities(const char* text, size_t size) {
+        std::array<size_t, ALPHABET_SIZE> frequency{};
+        for (size_t i = 0; i < size; ++i) {
+            frequency[static_cast<unsigned char>(text[i])]++;
         }
 
-        double total = text.size();
-        double cumulative = 0.0;
-
-        for (const auto& pair : frequency) {
-            double prob = pair.second / total;
-            probabilities[pair.first] = prob;
-            ranges[pair.first] = {cumulative, cumulative + prob};
-            cumulative += prob;
+        double total = size;
+        present.fill(false);
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (frequency[c] > 0) {
+                probabilities[c] = frequency[c] / total;
+                present[c] = true;
+            }
         }
+        buildRanges();
     }
 
-    void loadRanges(const std::map<char, double>& loadedProbabilities) {
+    void buildRanges() {
         double cumulative = 0.0;
-        probabilities = loadedProbabilities;
+        symbolCount = 0;
+        for (int i = 0; i < ALPHABET_SIZE; ++i) {
+            unsigned char c = symbolAt(i);
+            if (present[c]) {
+                symbols[symbolCount++] = c;
+                rangeLow[c] = cumulative;
+                rangeHigh[c] = cumulative + probabilities[c];
+                cumulative += probabilities[c];
+            }
+        }
+    }
 
-        for (const auto& pair : probabilities) {
-            ranges[pair.first] = {cumulative, cumulative + pair.second};
-            cumulative += pair.second;
+    void loadRanges(const std::map<char, double>& loadedProbabilities) {
+        present.fill(false);
+        for (const auto& pair : loadedProbabilities) {
+            unsigned char c = static_cast<unsigned char>(pair.first);
+            probabilities[c] = pair.second;
+            present[c] = true;
         }
+        buildRanges();
     }
 
 public:
-    std::pair<std::string, std::map<char, double>> compress(const std::string& text) {
-        calculateProbabilities(text);
+    // El valor codificado se escribe como texto con 16 digitos significativos;
+    // cabe siempre en este tamaño, sin importar la longitud de la entrada.
+    static size_t compressBound(size_t) {
+        return 32;
+    }
+
+    // Codifica en el buffer del llamador y devuelve cuantos caracteres se
+    // escribieron. Las probabilidades quedan disponibles en getProbabilities.
+    size_t compress(const char* text, size_t size, char* out, size_t capacity) {
+        metrics::PhaseTimer modelTimer;
+        calculateProbabilities(text, size);
+        METRIC_ADD("phase_model_ns_total", modelTimer.elapsedNanoseconds());
 
+        metrics::PhaseTimer encodeTimer;
         double low = 0.0;
         double high = 1.0;
 
-        for (char c : text) {
+        for (size_t i = 0; i < size; ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
             double range = high - low;
-            high = low + range * ranges[c].second;
-            low = low + range * ranges[c].first;
+            high = low + range * rangeHigh[c];
+            low = low + range * rangeLow[c];
         }
 
         double encodedValue = (low + high) / 2;
-        std::ostringstream oss;
-        oss << std::setprecision(16) << encodedValue; // Alta precisión
-        return {oss.str(), probabilities};
+        int written = std::snprintf(out, capacity, "%.16g", encodedValue); // Alta precisión
+        if (written < 0 || static_cast<size_t>(written) >= capacity) {
+            throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+        }
+        METRIC_ADD("qm_symbols_total", size);
+        METRIC_ADD("qm_output_bits_total", written * 8);
+        METRIC_ADD("phase_encode_ns_total", encodeTimer.elapsedNanoseconds());
+        return written;
     }
 
-    std::string decompress(const std::string& compressed, const std::map<char, double>& loadedProbabilities, size_t originalSize) {
-        loadRanges(loadedProbabilities);
+    // Decodifica 'originalSize' bytes en el buffer del llamador usando las
+    // probabilidades cargadas con loadProbabilities.
+    size_t decompress(const char* compressed, size_t compressedSize, char* out, size_t capacity, size_t originalSize) {
+        metrics::PhaseTimer decodeTimer;
+        char number[64];
+        if (compressedSize >= sizeof(number) || originalSize > capacity) {
+            throw std::runtime_error("Error en la descompresión: buffer de salida insuficiente.");
+        }
+        std::copy(compressed, compressed + compressedSize, number);
+        number[compressedSize] = '\0';
 
-        double value = std::stod(compressed);
-        std::string decoded;
+        double value = std::strtod(number, nullptr);
+        size_t decoded = 0;
+        size_t searchSteps = 0;
 
         for (size_t i = 0; i < originalSize; ++i) {
-            for (const auto& pair : ranges) {
-                if (value >= pair.second.first && value < pair.second.second) {
-                    decoded += pair.first;
-                    double range = pair.second.second - pair.second.first;
-                    value = (value - pair.second.first) / range;
+            for (int j = 0; j < symbolCount; ++j) {
+                unsigned char c = symbols[j];
+                if (value >= rangeLow[c] && value < rangeHigh[c]) {
+                    out[decoded++] = static_cast<char>(c);
+                    double range = rangeHigh[c] - rangeLow[c];
+                    value = (value - rangeLow[c]) / range;
+                    searchSteps += j + 1;
                     break;
                 }
             }
         }
 
+        // Rangos revisados por simbolo: el costo de la busqueda lineal del
+        // modelo, que crece con el tamaño del alfabeto presente.
+        METRIC_ADD("qm_decoded_symbols_total", decoded);
+        METRIC_ADD("qm_range_search_steps_total", searchSteps);
+        METRIC_ADD("phase_decode_ns_total", decodeTimer.elapsedNanoseconds());
+        return decoded;
+    }
+
+    // Mayor tamaño de la tabla de probabilidades serializada: la cantidad de
+    // simbolos y, por cada uno, el byte y su probabilidad.
+    static constexpr size_t MAX_TABLE_SIZE = sizeof(size_t) + ALPHABET_SIZE * (1 + sizeof(double));
+
+    size_t probabilityTableSize() const {
+        return sizeof(size_t) + symbolCount * (1 + sizeof(double));
+    }
+
+    // Escribe la tabla de probabilidades en el buffer del llamador, en el
+    // orden de los rangos (el mismo del archivo), y devuelve cuantos bytes
+    // ocupo.
+    size_t writeProbabilities(char* out, size_t capacity) const {
+        size_t tableSize = probabilityTableSize();
+        if (tableSize > capacity) {
+            throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+        }
+
+        size_t count = symbolCount;
+        std::memcpy(out, &count, sizeof(count));
+        size_t written = sizeof(count);
+        for (int i = 0; i < symbolCount; ++i) {
+            unsigned char c = symbols[i];
+            out[written++] = static_cast<char>(c);
+            std::memcpy(out + written, &probabilities[c], sizeof(double));
+            written += sizeof(double);
+        }
+        return written;
+    }
+
+    // Lee una tabla escrita con writeProbabilities, arma los rangos y
+    // devuelve cuantos bytes consumio.
+    size_t readProbabilities(const char* in, size_t size) {
+        metrics::PhaseTimer modelTimer;
+        size_t count = 0;
+        if (size < sizeof(count)) {
+            throw std::runtime_error("Error en la descompresión: tabla de probabilidades inválida.");
+        }
+        std::memcpy(&count, in, sizeof(count));
+        if (count > ALPHABET_SIZE || (size - sizeof(count)) / (1 + sizeof(double)) < count) {
+            throw std::runtime_error("Error en la descompresión: tabla de probabilidades inválida.");
+        }
+
+        size_t read = sizeof(count);
+        present.fill(false);
+        for (size_t i = 0; i < count; ++i) {
+            unsigned char c = static_cast<unsigned char>(in[read++]);
+            std::memcpy(&probabilities[c], in + read, sizeof(double));
+            read += sizeof(double);
+            present[c] = true;
+        }
+        buildRanges();
+        METRIC_ADD("phase_model_ns_total", modelTimer.elapsedNanoseconds());
+        return read;
+    }
+
+    void loadProbabilities(const std::map<char, double>& loadedProbabilities) {
+        metrics::PhaseTimer modelTimer;
+        loadRanges(loadedProbabilities);
+        METRIC_ADD("phase_model_ns_total", modelTimer.elapsedNanoseconds());
+    }
+
+    std::map<char, double> getProbabilities() const {
+        std::map<char, double> result;
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (present[c]) {
+                result[static_cast<char>(c)] = probabilities[c];
+            }
+        }
+        return result;
+    }
+
+    std::pair<std::string, std::map<char, double>> compress(const std::string& text) {
+        char buffer[32];
+        size_t written = compress(text.data(), text.size(), buffer, sizeof(buffer));
+        return {std::string(buffer, written), getProbabilities()};
+    }
+
+    std::string decompress(const std::string& compressed, const std::map<char, double>& loadedProbabilities, size_t originalSize) {
+        loadProbabilities(loadedProbabilities);
+
+        std::string decoded(originalSize, '\0');
+        decoded.resize(decompress(compressed.data(), compressed.size(), &decoded[0], decoded.size(), originalSize));
         return decoded;
     }
 };
 
+METRIC_RATIO("qm_bits_per_symbol", "qm_output_bits_total", "qm_symbols_total");
+METRIC_RATIO("qm_average_range_search_steps", "qm_range_search_steps_total", "qm_decoded_symbols_total");
+
+void writeCompressed(std::ostream& compressedFile, const char* compressed, size_t compressedSize,
+                     const QMCoder& qm, size_t originalSize) {
+    compressedFile.write(compressed, compressedSize);
+    compressedFile.put('\n');
+
+    char table[QMCoder::MAX_TABLE_SIZE];
+    size_t tableSize = qm.writeProbabilities(table, sizeof(table));
+    compressedFile.write(table, tableSize);
+
+    compressedFile.write(reinterpret_cast<const char*>(&originalSize), sizeof(originalSize));
+}
+
+void readCompressed(std::istream& compressedFile, std::string& compressed,
+                    QMCoder& qm, size_t& originalSize) {
+    std::getline(compressedFile, compressed);
+
+    // La tabla se lee completa en un buffer fijo y se carga de una vez.
+    char table[QMCoder::MAX_TABLE_SIZE];
+    size_t mapSize = 0;
+    compressedFile.read(reinterpret_cast<char*>(&mapSize), sizeof(mapSize));
+    std::memcpy(table, &mapSize, sizeof(mapSize));
+    size_t tableSize = sizeof(mapSize);
+    if (mapSize <= (sizeof(table) - tableSize) / (1 + sizeof(double))) {
+        compressedFile.read(table + tableSize, mapSize * (1 + sizeof(double)));
+        tableSize += compressedFile.gcount();
+    }
+    qm.readProbabilities(table, tableSize);
+
+    originalSize = 0;
+    compressedFile.read(reinterpret_cast<char*>(&originalSize), sizeof(originalSize));
+}
+
 void compressFile(const std::string& inputFileName, const std::string& compressedFileName) {
+    METRICS_BEGIN_RUN();
     QMCoder qm;
+    metrics::PhaseTimer readTimer;
     std::ifstream inputFile(inputFileName);
     if (!inputFile.is_open()) {
         std::cerr << "Error: No se pudo abrir el archivo original." << std::endl;
@@ -88,63 +279,55 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
 
     std::string text((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
     inputFile.close();
+    METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
 
     auto start = std::chrono::high_resolution_clock::now();
-    auto [compressed, probabilities] = qm.compress(text);
+    char compressed[32];
+    size_t compressedSize = qm.compress(text.data(), text.size(), compressed, sizeof(compressed));
     auto end = std::chrono::high_resolution_clock::now();
 
+    metrics::PhaseTimer writeTimer;
     std::ofstream compressedFile(compressedFileName, std::ios::binary);
     if (!compressedFile.is_open()) {
         std::cerr << "Error: No se pudo crear el archivo comprimido." << std::endl;
         return;
     }
 
-    compressedFile << compressed << "\n";
-
-    size_t mapSize = probabilities.size();
-    compressedFile.write(reinterpret_cast<const char*>(&mapSize), sizeof(mapSize));
-    for (const auto& pair : probabilities) {
-        compressedFile.put(pair.first);
-        double probability = pair.second;
-        compressedFile.write(reinterpret_cast<const char*>(&probability), sizeof(probability));
-    }
-
-    size_t originalSize = text.size();
-    compressedFile.write(reinterpret_cast<const char*>(&originalSize), sizeof(originalSize));
+    writeCompressed(compressedFile, compressed, compressedSize, qm, text.size());
     compressedFile.close();
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo comprimido en: " << compressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
 }
 
 void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName) {
+    METRICS_BEGIN_RUN();
     QMCoder qm;
+    std::string compressed;
+    size_t originalSize = 0;
+
+    metrics::PhaseTimer readTimer;
     std::ifstream compressedFile(compressedFileName, std::ios::binary);
     if (!compressedFile.is_open()) {
         std::cerr << "Error: No se pudo abrir el archivo comprimido." << std::endl;
         return;
     }
 
-    std::string compressed;
-    std::getline(compressedFile, compressed);
-
-    size_t mapSize;
-    compressedFile.read(reinterpret_cast<char*>(&mapSize), sizeof(mapSize));
-
-    std::map<char, double> probabilities;
-    for (size_t i = 0; i < mapSize; ++i) {
-        char character = compressedFile.get();
-        double probability;
-        compressedFile.read(reinterpret_cast<char*>(&probability), sizeof(probability));
-        probabilities[character] = probability;
-    }
-
-    size_t originalSize;
-    compressedFile.read(reinterpret_cast<char*>(&originalSize), sizeof(originalSize));
-    compressedFile.close();
-
+    std::string decompressed;
     auto start = std::chrono::high_resolution_clock::now();
-    std::string decompressed = qm.decompress(compressed, probabilities, originalSize);
+    try {
+        readCompressed(compressedFile, compressed, qm, originalSize);
+        compressedFile.close();
+        METRIC_ADD("phase_read_ns_total", readTimer.elapsedNanoseconds());
+
+        start = std::chrono::high_resolution_clock::now();
+        decompressed.resize(originalSize);
+        decompressed.resize(qm.decompress(compressed.data(), compressed.size(), &decompressed[0], decompressed.size(), originalSize));
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
     auto end = std::chrono::high_resolution_clock::now();
 
     if (decompressed.empty()) {
@@ -152,6 +335,7 @@ void decompressFile(const std::string& compressedFileName, const std::string& de
         return;
     }
 
+    metrics::PhaseTimer writeTimer;
     std::ofstream decompressedFile(decompressedFileName);
     if (!decompressedFile.is_open()) {
         std::cerr << "Error: No se pudo crear el archivo descomprimido." << std::endl;
@@ -160,6 +344,7 @@ void decompressFile(const std::string& compressedFileName, const std::string& de
 
     decompressedFile << decompressed;
     decompressedFile.close();
+    METRIC_ADD("phase_write_ns_total", writeTimer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo descomprimido en: " << decompressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
@@ -174,7 +359,8 @@ int main() {
         std::cout << "\n--- Menu QM Coder ---" << std::endl;
         std::cout << "1. Comprimir archivo" << std::endl;
         std::cout << "2. Descomprimir archivo" << std::endl;
-        std::cout << "3. Salir" << std::endl;
+        std::cout << "3. Exportar metricas (.json o .prom)" << std::endl;
+        std::cout << "4. Salir" << std::endl;
         std::cout << "Seleccione una opcion: ";
 
         int choice;
@@ -193,6 +379,11 @@ int main() {
             std::cin >> decompressedFileName;
             decompressFile(compressedFileName, decompressedFileName);
         } else if (choice == 3) {
+            std::string metricsFileName;
+            std::cout << "Ingrese el nombre del archivo de metricas: ";
+            std::cin >> metricsFileName;
+            exportMetrics(metricsFileName);
+        } else if (choice == 4) {
             std::cout << "Saliendo..." << std::endl;
             break;
         } else {
@@ -4,27 +4,52 @@
 #include <unordered_map>
 #include <string>
 #include <algorithm>
-#include <numeric>
 #include <chrono>
 #include <filesystem>
+#include <array>
+#include <stdexcept>
+#include <cstring>
+#include "../comun/async_io.h"
+#include "../comun/batch.h"
+#include "../comun/bwt.h"
+#include "../comun/magic.h"
+#include "../comun/metrics.h"
 
 class ShannonFano {
 private:
-    std::unordered_map<char, std::string> codes;
-    std::unordered_map<std::string, char> reverse_codes;
-
-    void build_tree(std::vector<std::pair<char, int>>& frequencies, const std::string& prefix) {
-        if (frequencies.size() == 1) {
-            codes[frequencies[0].first] = prefix;
+    // Alfabeto de bytes; con 256 simbolos ningun codigo puede superar los
+    // 255 bits.
+    static constexpr int ALPHABET_SIZE = 256;
+    static constexpr size_t MAX_CODE_LENGTH = ALPHABET_SIZE - 1;
+
+    // Las tablas viven en el objeto y se reutilizan entre llamadas: en
+    // regimen estable compress/decompress no reservan memoria.
+    std::array<int, ALPHABET_SIZE> freq_table{};
+    std::array<std::string, ALPHABET_SIZE> code_table;
+    std::array<bool, ALPHABET_SIZE> has_code{};
+    std::vector<std::pair<unsigned char, int>> frequencies;
+    std::string prefix;
+
+    // Arbol de decodificacion: hijos de cada nodo para los bits '0' y '1'
+    // (-1 si no existe) y el simbolo de las hojas.
+    std::vector<std::array<int, 2>> decode_nodes;
+    std::vector<int> decode_symbols;
+
+    void build_tree(size_t begin, size_t end) {
+        if (end - begin == 1) {
+            code_table[frequencies[begin].first].assign(prefix);
+            has_code[frequencies[begin].first] = true;
             return;
         }
 
-        int total = std::accumulate(frequencies.begin(), frequencies.end(), 0,
-                                    [](int sum, const std::pair<char, int>& p) { return sum + p.second; });
+        int total = 0;
+        for (size_t i = begin; i < end; ++i) {
+            total += frequencies[i].second;
+        }
 
         int acc = 0;
-        size_t split = 0;
-        for (size_t i = 0; i < frequencies.size(); ++i) {
+        size_t split = begin;
+        for (size_t i = begin; i < end; ++i) {
             if (acc + frequencies[i].second > total / 2) {
                 break;
             }
@@ -32,121 +57,376 @@ private:
             split = i;
         }
 
-        auto left = std::vector<std::pair<char, int>>(frequencies.begin(), frequencies.begin() + split + 1);
-        auto right = std::vector<std::pair<char, int>>(frequencies.begin() + split + 1, frequencies.end());
+        prefix.push_back('0');
+        build_tree(begin, split + 1);
+        prefix.back() = '1';
+        build_tree(split + 1, end);
+        prefix.pop_back();
+    }
+
+    int add_decode_node() {
+        decode_nodes.push_back({-1, -1});
+        decode_symbols.push_back(-1);
+        return static_cast<int>(decode_nodes.size()) - 1;
+    }
+
+    void reset_decode_tree() {
+        decode_nodes.clear();
+        decode_symbols.clear();
+        add_decode_node();
+    }
 
-        build_tree(left, prefix + "0");
-        build_tree(right, prefix + "1");
+    void insert_code(const char* bits, size_t length, unsigned char symbol) {
+        int node = 0;
+        for (size_t i = 0; i < length; ++i) {
+            int branch = bits[i] == '1' ? 1 : 0;
+            if (decode_nodes[node][branch] < 0) {
+                int child = add_decode_node();
+                decode_nodes[node][branch] = child;
+            }
+            node = decode_nodes[node][branch];
+        }
+        decode_symbols[node] = symbol;
     }
 
 public:
+    // Un codigo prefijo de n simbolos tiene a lo sumo 2n - 1 nodos, asi que
+    // el arbol de decodificacion nunca crece despues de esta reserva.
+    ShannonFano() {
+        frequencies.reserve(ALPHABET_SIZE);
+        decode_nodes.reserve(2 * ALPHABET_SIZE);
+        decode_symbols.reserve(2 * ALPHABET_SIZE);
+    }
+
+    // Peor caso del texto de bits que produce compress para 'size' bytes.
+    static size_t compress_bound(size_t size) {
+        return size * MAX_CODE_LENGTH;
+    }
+
     void clear_codes() {
-        codes.clear();
-        reverse_codes.clear();
+        has_code.fill(false);
+        decode_nodes.clear();
+        decode_symbols.clear();
     }
 
-    std::string compress(const std::string& text) {
+    // Construye los codigos para el texto y devuelve el tamaño exacto que
+    // tendra su codificacion.
+    size_t build_codes(const char* text, size_t size) {
+        metrics::PhaseTimer model_timer;
         clear_codes();
-        std::unordered_map<char, int> freq_map;
-        for (char c : text) {
-            freq_map[c]++;
+        freq_table.fill(0);
+        for (size_t i = 0; i < size; ++i) {
+            freq_table[static_cast<unsigned char>(text[i])]++;
         }
 
-        std::vector<std::pair<char, int>> frequencies(freq_map.begin(), freq_map.end());
+        frequencies.clear();
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (freq_table[c] > 0) {
+                frequencies.push_back({static_cast<unsigned char>(c), freq_table[c]});
+            }
+        }
         std::sort(frequencies.begin(), frequencies.end(), [](const auto& a, const auto& b) {
-            return b.second > a.second;
+            return b.second > a.second || (b.second == a.second && a.first < b.first);
         });
 
-        build_tree(frequencies, "");
-        for (const auto& p : codes) {
-            reverse_codes[p.second] = p.first;
+        if (frequencies.empty()) {
+            return 0;
+        }
+        // Con un solo simbolo el arbol no se divide y el codigo quedaria
+        // vacio, sin bits que decodificar; recibe el codigo "0".
+        prefix.clear();
+        if (frequencies.size() == 1) {
+            prefix.push_back('0');
         }
+        build_tree(0, frequencies.size());
 
-        std::string compressed;
-        for (char c : text) {
-            compressed += codes[c];
+        size_t encoded_size = 0;
+        size_t max_code_length = 0;
+        for (const auto& p : frequencies) {
+            encoded_size += static_cast<size_t>(p.second) * code_table[p.first].size();
+            max_code_length = std::max(max_code_length, code_table[p.first].size());
         }
+        METRIC_MAX("sf_distinct_symbols", frequencies.size());
+        METRIC_MAX("sf_max_code_length", max_code_length);
+        METRIC_ADD("phase_model_ns_total", model_timer.elapsedNanoseconds());
+        return encoded_size;
+    }
 
-        return compressed;
+    // Codifica con los codigos actuales en el buffer del llamador y devuelve
+    // cuantos bits ('0'/'1') se escribieron.
+    size_t encode(const char* text, size_t size, char* out, size_t capacity) const {
+        metrics::PhaseTimer encode_timer;
+        size_t written = 0;
+        for (size_t i = 0; i < size; ++i) {
+            const std::string& code = code_table[static_cast<unsigned char>(text[i])];
+            if (code.size() > capacity - written) {
+                throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+            }
+            std::copy(code.begin(), code.end(), out + written);
+            written += code.size();
+        }
+        METRIC_ADD("sf_symbols_total", size);
+        METRIC_ADD("sf_encoded_bits_total", written);
+        METRIC_ADD("phase_encode_ns_total", encode_timer.elapsedNanoseconds());
+        return written;
     }
 
-    std::string decompress(const std::string& compressed, const std::unordered_map<std::string, char>& loaded_codes) {
-        reverse_codes = loaded_codes;
-
-        std::string decoded;
-        std::string current;
-        for (char bit : compressed) {
-            current += bit;
-            if (reverse_codes.find(current) != reverse_codes.end()) {
-                decoded += reverse_codes[current];
-                current.clear();
+    size_t compress(const char* text, size_t size, char* out, size_t capacity) {
+        build_codes(text, size);
+        return encode(text, size, out, capacity);
+    }
+
+    // Tamaño de la tabla de codigos serializada: la cantidad de codigos y,
+    // por cada uno, el byte, la longitud y los bits.
+    size_t code_table_size() const {
+        size_t size = sizeof(size_t);
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (has_code[c]) {
+                size += 1 + sizeof(size_t) + code_table[c].size();
+            }
+        }
+        return size;
+    }
+
+    // Escribe la tabla de codigos actual en el buffer del llamador, con el
+    // formato del archivo, y devuelve cuantos bytes ocupo.
+    size_t write_codes(char* out, size_t capacity) const {
+        size_t table_size = code_table_size();
+        if (table_size > capacity) {
+            throw std::runtime_error("Error en la compresión: buffer de salida insuficiente.");
+        }
+
+        size_t count = std::count(has_code.begin(), has_code.end(), true);
+        std::memcpy(out, &count, sizeof(count));
+        size_t written = sizeof(count);
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (has_code[c]) {
+                const std::string& code = code_table[c];
+                size_t code_length = code.size();
+                out[written++] = static_cast<char>(c);
+                std::memcpy(out + written, &code_length, sizeof(code_length));
+                written += sizeof(code_length);
+                std::copy(code.begin(), code.end(), out + written);
+                written += code_length;
+            }
+        }
+        return written;
+    }
+
+    // Lee una tabla escrita con write_codes, arma el arbol de decodificacion
+    // y devuelve cuantos bytes consumio; los bits empiezan a continuacion.
+    size_t read_codes(const char* in, size_t size) {
+        metrics::PhaseTimer model_timer;
+        reset_decode_tree();
+
+        size_t count = 0;
+        if (size < sizeof(count)) {
+            throw std::runtime_error("Error en la descompresión: tabla de códigos inválida.");
+        }
+        std::memcpy(&count, in, sizeof(count));
+        if (count > ALPHABET_SIZE) {
+            throw std::runtime_error("Error en la descompresión: tabla de códigos inválida.");
+        }
+
+        size_t read = sizeof(count);
+        for (size_t i = 0; i < count; ++i) {
+            size_t code_length = 0;
+            if (size - read < 1 + sizeof(code_length)) {
+                throw std::runtime_error("Error en la descompresión: tabla de códigos inválida.");
+            }
+            unsigned char symbol = static_cast<unsigned char>(in[read++]);
+            std::memcpy(&code_length, in + read, sizeof(code_length));
+            read += sizeof(code_length);
+            if (code_length > MAX_CODE_LENGTH || code_length > size - read) {
+                throw std::runtime_error("Error en la descompresión: tabla de códigos inválida.");
+            }
+            insert_code(in + read, code_length, symbol);
+            read += code_length;
+        }
+        METRIC_ADD("phase_model_ns_total", model_timer.elapsedNanoseconds());
+        return read;
+    }
+
+    // Carga los codigos leidos del archivo en el arbol de decodificacion.
+    void load_codes(const std::unordered_map<std::string, char>& loaded_codes) {
+        metrics::PhaseTimer model_timer;
+        reset_decode_tree();
+        for (const auto& p : loaded_codes) {
+            insert_code(p.first.data(), p.first.size(), static_cast<unsigned char>(p.second));
+        }
+        METRIC_ADD("phase_model_ns_total", model_timer.elapsedNanoseconds());
+    }
+
+    // Decodifica con los codigos cargados en el buffer del llamador y
+    // devuelve cuantos bytes se escribieron.
+    size_t decode(const char* compressed, size_t size, char* out, size_t capacity) const {
+        metrics::PhaseTimer decode_timer;
+        size_t written = 0;
+        int node = 0;
+        for (size_t i = 0; i < size; ++i) {
+            node = decode_nodes[node][compressed[i] == '1' ? 1 : 0];
+            if (node < 0) {
+                throw std::runtime_error("Error en la descompresión: código no encontrado.");
+            }
+            if (decode_symbols[node] >= 0) {
+                if (written == capacity) {
+                    throw std::runtime_error("Error en la descompresión: buffer de salida insuficiente.");
+                }
+                out[written++] = static_cast<char>(decode_symbols[node]);
+                node = 0;
             }
         }
+        METRIC_ADD("sf_decoded_symbols_total", written);
+        METRIC_ADD("sf_decoded_bits_total", size);
+        METRIC_ADD("phase_decode_ns_total", decode_timer.elapsedNanoseconds());
+        return written;
+    }
+
+    std::string compress(const std::string& text) {
+        std::string compressed(build_codes(text.data(), text.size()), '0');
+        encode(text.data(), text.size(), &compressed[0], compressed.size());
+        return compressed;
+    }
 
+    std::string decompress(const std::string& compressed, const std::unordered_map<std::string, char>& loaded_codes) {
+        load_codes(loaded_codes);
+
+        // Cada simbolo ocupa al menos un bit.
+        std::string decoded(compressed.size(), '\0');
+        decoded.resize(decode(compressed.data(), compressed.size(), &decoded[0], decoded.size()));
         return decoded;
     }
 
-    const std::unordered_map<char, std::string>& get_codes() const {
+    std::unordered_map<char, std::string> get_codes() const {
+        std::unordered_map<char, std::string> codes;
+        for (int c = 0; c < ALPHABET_SIZE; ++c) {
+            if (has_code[c]) {
+                codes[static_cast<char>(c)] = code_table[c];
+            }
+        }
         return codes;
     }
 };
 
-void saveCompressedFile(const std::string& compressed, const std::unordered_map<char, std::string>& codes, const std::string& compressedFileName) {
+METRIC_RATIO("sf_bits_per_symbol", "sf_encoded_bits_total", "sf_symbols_total");
+METRIC_RATIO("sf_decoded_bits_per_symbol", "sf_decoded_bits_total", "sf_decoded_symbols_total");
+
+void writeCompressed(std::ostream& outFile, const char* compressed, size_t compressedSize, const ShannonFano& sf) {
+    // Guardar la tabla de códigos
+    std::string table(sf.code_table_size(), '\0');
+    sf.write_codes(&table[0], table.size());
+    outFile.write(table.data(), table.size());
+
+    // Guardar los datos comprimidos
+    outFile.write(compressed, compressedSize);
+}
+
+// Decodifica un registro completo (tabla de codigos seguida de los bits).
+std::string decompressRecord(ShannonFano& sf, const char* record, size_t size) {
+    size_t table_size = sf.read_codes(record, size);
+
+    // Cada simbolo ocupa al menos un bit.
+    std::string decoded(size - table_size, '\0');
+    decoded.resize(sf.decode(record + table_size, size - table_size, &decoded[0], decoded.size()));
+    return decoded;
+}
+
+void saveCompressedFile(const std::string& compressed, const ShannonFano& sf, const std::string& compressedFileName, bool use_bwt) {
     std::ofstream outFile(compressedFileName, std::ios::binary);
     if (!outFile.is_open()) {
         std::cerr << "Error al escribir el archivo comprimido." << std::endl;
         return;
     }
 
-    // Guardar el tamaño del mapa de códigos
-    size_t mapSize = codes.size();
-    outFile.write(reinterpret_cast<const char*>(&mapSize), sizeof(mapSize));
-
-    // Guardar los códigos
-    for (const auto& pair : codes) {
-        outFile.put(pair.first);
-        size_t codeLength = pair.second.size();
-        outFile.write(reinterpret_cast<const char*>(&codeLength), sizeof(codeLength));
-        outFile.write(pair.second.data(), codeLength);
+    if (use_bwt) {
+        outFile.write(bwt::MAGIC, sizeof(bwt::MAGIC));
     }
 
-    // Guardar los datos comprimidos
-    outFile.write(compressed.data(), compressed.size());
+    writeCompressed(outFile, compressed.data(), compressed.size(), sf);
     outFile.close();
 }
 
-std::pair<std::unordered_map<std::string, char>, std::string> loadCompressedFile(const std::string& compressedFileName) {
+// Devuelve el registro (tabla de codigos y bits) que sigue a la firma BWT,
+// o una cadena vacia si el archivo no se pudo leer.
+std::string loadCompressedFile(const std::string& compressedFileName, bool& use_bwt) {
     std::ifstream inFile(compressedFileName, std::ios::binary);
     if (!inFile.is_open()) {
         std::cerr << "Error al leer el archivo comprimido." << std::endl;
-        return {{}, ""};
+        return "";
     }
 
-    std::unordered_map<std::string, char> loaded_codes;
+    use_bwt = consumeMagic(inFile, bwt::MAGIC);
 
-    // Leer el tamaño del mapa de códigos
-    size_t mapSize;
-    inFile.read(reinterpret_cast<char*>(&mapSize), sizeof(mapSize));
+    std::string record((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+    inFile.close();
 
-    // Leer los códigos
-    for (size_t i = 0; i < mapSize; ++i) {
-        char character = inFile.get();
-        size_t codeLength;
-        inFile.read(reinterpret_cast<char*>(&codeLength), sizeof(codeLength));
-        std::string code(codeLength, ' ');
-        inFile.read(&code[0], codeLength);
-        loaded_codes[code] = character;
-    }
+    return record;
+}
 
-    // Leer los datos comprimidos
-    std::string compressed((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
-    inFile.close();
+// Comprime un bloque del lote o del canal asincrono con el codificador del
+// hilo que lo atiende. La firma, la tabla y los bits se escriben en un solo
+// buffer del tamaño exacto. La etapa BWT reparte el bloque entre
+// 'bwt_threads' hilos.
+std::string compressBlock(ShannonFano& sf, const char* data, size_t size, bool use_bwt, size_t bwt_threads) {
+    std::string transformed;
+    if (use_bwt) {
+        transformed = bwt::encode(data, size, bwt::DEFAULT_BLOCK_SIZE, bwt_threads);
+        data = transformed.data();
+        size = transformed.size();
+    }
+    size_t bit_count = sf.build_codes(data, size);
+    size_t magic_size = use_bwt ? sizeof(bwt::MAGIC) : 0;
+    size_t table_size = sf.code_table_size();
+
+    std::string payload(magic_size + table_size + bit_count, '\0');
+    std::copy(bwt::MAGIC, bwt::MAGIC + magic_size, &payload[0]);
+    sf.write_codes(&payload[magic_size], table_size);
+    sf.encode(data, size, &payload[magic_size + table_size], bit_count);
+    return payload;
+}
 
-    return {loaded_codes, compressed};
+// Descomprime un bloque escrito por compressBlock; 'record' es un buffer
+// reutilizable para la tabla y los bits.
+std::string decompressBlock(ShannonFano& sf, std::string& record, std::istream& payload, size_t bwt_threads) {
+    bool use_bwt = consumeMagic(payload, bwt::MAGIC);
+    record.assign(std::istreambuf_iterator<char>(payload), std::istreambuf_iterator<char>());
+    std::string decoded = decompressRecord(sf, record.data(), record.size());
+    return use_bwt ? bwt::decode(decoded, bwt_threads) : decoded;
 }
 
-void compressFile(const std::string& inputFileName, const std::string& compressedFileName) {
+// Bloques BWT que puede llevar un bloque del canal asincrono.
+const size_t PIPELINE_BWT_BLOCKS = 4;
+
+// Con 'use_bwt' el texto pasa antes por la etapa BWT + move-to-front y el
+// archivo empieza con bwt::MAGIC. El formato sin la etapa no cambia: su
+// primer campo es el tamaño del mapa de codigos, que nunca coincide con la
+// firma.
+void compressFile(const std::string& inputFileName, const std::string& compressedFileName, bool use_bwt) {
+    METRICS_BEGIN_RUN();
     ShannonFano sf;
+
+    // Los archivos grandes van por bloques, solapando lectura, compresion
+    // y escritura. Con la etapa BWT cada bloque del canal lleva hasta
+    // PIPELINE_BWT_BLOCKS bloques BWT de tamaño normal, que compressBlock
+    // transforma en paralelo; el tope mantiene acotados los buffers del
+    // canal y el umbral de usePipeline sin importar cuantos hilos haya.
+    PipelineOptions options;
+    size_t bwt_threads = std::min(bwt::defaultThreadCount(), PIPELINE_BWT_BLOCKS);
+    if (use_bwt) {
+        options.blockSize = bwt::DEFAULT_BLOCK_SIZE * bwt_threads;
+    }
+    if (usePipeline(inputFileName, options)) {
+        PipelineStats stats = compressPipelined(inputFileName, compressedFileName, [&](size_t, const char* data, size_t size) {
+            return compressBlock(sf, data, size, use_bwt, bwt_threads);
+        }, options);
+        if (stats.ok) {
+            std::cout << "Archivo comprimido en: " << compressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
+    metrics::PhaseTimer read_timer;
     std::ifstream inputFile(inputFileName);
     if (!inputFile.is_open()) {
         std::cerr << "No se pudo abrir el archivo original." << std::endl;
@@ -155,12 +435,15 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
 
     std::string text((std::istreambuf_iterator<char>(inputFile)), std::istreambuf_iterator<char>());
     inputFile.close();
+    METRIC_ADD("phase_read_ns_total", read_timer.elapsedNanoseconds());
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::string compressed = sf.compress(text);
+    std::string compressed = sf.compress(use_bwt ? bwt::encode(text) : text);
     auto end = std::chrono::high_resolution_clock::now();
 
-    saveCompressedFile(compressed, sf.get_codes(), compressedFileName);
+    metrics::PhaseTimer write_timer;
+    saveCompressedFile(compressed, sf, compressedFileName, use_bwt);
+    METRIC_ADD("phase_write_ns_total", write_timer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     size_t originalSize = text.size();
@@ -173,25 +456,73 @@ void compressFile(const std::string& inputFileName, const std::string& compresse
 }
 
 void decompressFile(const std::string& compressedFileName, const std::string& decompressedFileName) {
+    METRICS_BEGIN_RUN();
     ShannonFano sf;
-    auto [loaded_codes, compressed] = loadCompressedFile(compressedFileName);
-    if (compressed.empty()) {
+
+    std::string record;
+    PipelineStats stats;
+    bool is_block_file = decompressPipelined(compressedFileName, decompressedFileName, [&](std::istream& block) {
+        return decompressBlock(sf, record, block, std::min(bwt::defaultThreadCount(), PIPELINE_BWT_BLOCKS));
+    }, stats);
+    if (is_block_file) {
+        if (stats.ok) {
+            std::cout << "Archivo descomprimido en: " << decompressedFileName << std::endl;
+            printPipelineStats(stats);
+        }
+        return;
+    }
+
+    metrics::PhaseTimer read_timer;
+    bool use_bwt = false;
+    record = loadCompressedFile(compressedFileName, use_bwt);
+    METRIC_ADD("phase_read_ns_total", read_timer.elapsedNanoseconds());
+    if (record.empty()) {
         std::cerr << "Error al cargar el archivo comprimido." << std::endl;
         return;
     }
 
     auto start = std::chrono::high_resolution_clock::now();
-    std::string decompressed = sf.decompress(compressed, loaded_codes);
+    std::string decompressed;
+    try {
+        decompressed = decompressRecord(sf, record.data(), record.size());
+        if (use_bwt) {
+            decompressed = bwt::decode(decompressed);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return;
+    }
     auto end = std::chrono::high_resolution_clock::now();
 
+    metrics::PhaseTimer write_timer;
     std::ofstream decompressedFile(decompressedFileName);
     decompressedFile << decompressed;
     decompressedFile.close();
+    METRIC_ADD("phase_write_ns_total", write_timer.elapsedNanoseconds());
 
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     std::cout << "Archivo descomprimido en: " << decompressedFileName << " (Tiempo: " << duration << " ms)" << std::endl;
 }
 
+void compressBatchFiles(const std::vector<std::string>& inputs, const std::string& outputDir, bool use_bwt) {
+    METRICS_BEGIN_RUN();
+    BatchOptions options;
+
+    // Un contexto por hilo, con sus tablas y buffers reutilizables. Los
+    // bloques ya se reparten entre hilos, asi que la etapa BWT corre en el
+    // hilo del bloque.
+    std::vector<ShannonFano> coders(options.threadCount);
+    std::vector<std::string> records(options.threadCount);
+
+    auto stats = compressBatch(inputs, outputDir, [&](size_t worker, const char* data, size_t size) {
+        return compressBlock(coders[worker], data, size, use_bwt, 1);
+    }, [&](size_t worker, std::istream& payload) {
+        return decompressBlock(coders[worker], records[worker], payload, 1);
+    }, options);
+
+    printBatchStats(stats);
+}
+
 int main() {
 
     system("chcp 65001");
@@ -201,13 +532,17 @@ int main() {
     std::string inputFileName;
     std::string compressedFileName;
     std::string decompressedFileName;
+    bool use_bwt = false;
 
     while (true) {
         std::cout << "\n--- Menu ---" << std::endl;
         std::cout <<"\n !Importante: \n La extension del archivo a comprimir\n debe ser '.txt'\n y la extension del archivo de salidad\npuede ser .sf o .compressed\n"<<std::endl;
         std::cout << "1. Comprimir archivo" << std::endl;
         std::cout << "2. Descomprimir archivo" << std::endl;
-        std::cout << "3. Salir" << std::endl;
+        std::cout << "3. Comprimir lote (directorios o archivos)" << std::endl;
+        std::cout << "4. Exportar metricas (.json o .prom)" << std::endl;
+        std::cout << "5. Transformacion BWT (actual: " << (use_bwt ? "activada" : "desactivada") << ")" << std::endl;
+        std::cout << "6. Salir" << std::endl;
         std::cout << "Seleccione una opcion: ";
 
         int choice;
@@ -218,7 +553,7 @@ int main() {
             std::cin >> inputFileName;
             std::cout << "Ingrese el nombre del archivo comprimido de salida: ";
             std::cin >> compressedFileName;
-            compressFile(inputFileName, compressedFileName);
+            compressFile(inputFileName, compressedFileName, use_bwt);
         } else if (choice == 2) {
             std::cout << "Ingrese el nombre del archivo comprimido: ";
             std::cin >> compressedFileName;
@@ -226,6 +561,24 @@ int main() {
             std::cin >> decompressedFileName;
             decompressFile(compressedFileName, decompressedFileName);
         } else if (choice == 3) {
+            std::vector<std::string> inputs;
+            std::string input;
+            std::cout << "Ingrese los directorios o archivos a comprimir ('fin' para terminar): ";
+            while (std::cin >> input && input != "fin") {
+                inputs.push_back(input);
+            }
+            std::cout << "Ingrese el directorio de salida: ";
+            std::cin >> compressedFileName;
+            compressBatchFiles(inputs, compressedFileName, use_bwt);
+        } else if (choice == 4) {
+            std::string metricsFileName;
+            std::cout << "Ingrese el nombre del archivo de metricas: ";
+            std::cin >> metricsFileName;
+            exportMetrics(metricsFileName);
+        } else if (choice == 5) {
+            use_bwt = !use_bwt;
+            std::cout << "Transformacion BWT " << (use_bwt ? "activada." : "desactivada.") << std::endl;
+        } else if (choice == 6) {
             std::cout << "Saliendo..." << std::endl;
             break;
         } else {